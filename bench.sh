@@ -0,0 +1,43 @@
+#!/bin/bash
+# Runs oss across a matrix of table sizes, concurrency limits, workload mixes, transports, launch modes, grant sizes
+# and worker loads
+# and prints one line of key=value results per run (see -b in oss). Results are also saved to bench.txt
+# Each dimension can be overridden from the environment, for example: JOBS=5000 TABLES="18" ./bench.sh
+# EXTRA adds options to every run, for example: LOADS="spin mem" EXTRA="-o 0 -k 1-3" ./bench.sh
+
+JOBS=${JOBS:-2000}
+TABLES=${TABLES:-"18 256"}
+CPUS=${CPUS:-"1 4"}
+MIXES=${MIXES:-"20,30 5,10 10,70"}
+TRANSPORTS=${TRANSPORTS:-"msgq mailbox"}
+LAUNCH=${LAUNCH:-"pool"}
+GRANTS=${GRANTS:-"1"}
+LOADS=${LOADS:-"none"}
+EXTRA=${EXTRA:-""}
+OUT=${OUT:-bench.txt}
+
+: > "$OUT"
+for table in $TABLES; do
+	for cpus in $CPUS; do
+		for mix in $MIXES; do
+			for transport in $TRANSPORTS; do
+				for launch in $LAUNCH; do
+					for grant in $GRANTS; do
+						for load in $LOADS; do
+							args="-b -e -a 0 -n $JOBS -s $table -c $cpus -w $mix -g $grant -l $load $EXTRA"
+							[ "$transport" = mailbox ] && args="$args -m"
+							[ "$launch" = pool ] && args="$args -p"
+							# Keep only the results line, the rest of oss's output is not needed here
+							line=$(./oss $args | grep '^BENCH ')
+							if [ -z "$line" ]; then
+								echo "bench: ./oss $args produced no results" >&2
+								exit 1
+							fi
+							echo "${line#BENCH }" | tee -a "$OUT"
+						done
+					done
+				done
+			done
+		done
+	done
+done
@@ -0,0 +1,238 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <vector>
+#include "checkpoint.h"
+
+// Header at the start of each slot. It is followed by one checksum per page of state, then by the state itself,
+// starting on a page boundary
+typedef struct
+{
+	char magic[8]; // "MLFQCKP2"
+	uint64_t generation; // Number of checkpoints written before this one, plus one
+	uint64_t size; // Bytes of state
+	uint64_t pageSize; // Bytes of state each page checksum covers
+	uint64_t checksum; // FNV-1a of the page checksums, to catch a slot whose write was cut short
+} slotHeader;
+
+static const char ckptMagic[8] = {'M', 'L', 'F', 'Q', 'C', 'K', 'P', '2'};
+
+static char* written = NULL; // File being checkpointed to, mapped shared
+static size_t writtenSize = 0; // Bytes mapped
+static size_t slotSize = 0; // Bytes of one slot, header included
+static size_t stateSize = 0; // Bytes of state in each checkpoint
+static size_t pageSize = 0; // Bytes of state each page checksum covers
+static size_t pageCount = 0; // Pages of state in each checkpoint
+static size_t stateOffset = 0; // Where the state starts in a slot
+static int nextSlot = 0; // Slot the next checkpoint goes in
+static uint64_t generation = 0; // Generation of the newest checkpoint
+
+// Pages of the slot being written whose bytes changed since that slot's last checkpoint. Only these get their
+// checksum recomputed at commit, the rest still match the checksums the slot already holds
+static std::vector<char> pageDirty;
+static std::vector<size_t> dirtyPages;
+// Set for a slot until its first commit, since checksums from an earlier run or a write cut short can not be trusted
+static int slotUnsummed[2] = {1, 1};
+
+static char* loaded = NULL; // File being restarted from, mapped read-only
+static size_t loadedSize = 0;
+
+// Function to checksum size bytes of data
+static uint64_t checksum(const char* data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (unsigned char)data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+// Function to get where the state starts in a slot holding size bytes of state with the given page size
+static size_t stateStart(size_t size, size_t page)
+{
+	size_t pages = (size + page - 1) / page;
+	return (sizeof(slotHeader) + pages * sizeof(uint64_t) + page - 1) / page * page;
+}
+
+// Function to check a slot holds a complete checkpoint: its page checksums match their checksum, and every page of
+// state matches its own. Returns its generation, or 0 if it does not
+static uint64_t slotGeneration(const char* slot, size_t room)
+{
+	const slotHeader* header = (const slotHeader*)slot;
+	if (memcmp(header->magic, ckptMagic, sizeof(ckptMagic)) != 0 || header->pageSize == 0 || header->size > room)
+		return 0;
+	size_t page = header->pageSize;
+	size_t pages = (header->size + page - 1) / page;
+	size_t start = stateStart(header->size, page);
+	if (start + header->size > room)
+		return 0;
+	const uint64_t* sums = (const uint64_t*)(slot + sizeof(slotHeader));
+	if (checksum((const char*)sums, pages * sizeof(uint64_t)) != header->checksum)
+		return 0;
+	for (size_t p = 0; p < pages; p++)
+	{
+		size_t len = p == pages - 1 ? header->size - p * page : page;
+		if (checksum(slot + start + p * page, len) != sums[p])
+			return 0;
+	}
+	return header->generation;
+}
+
+int ckptOpen(const char* path, size_t size)
+{
+	// Keep slots page aligned so each is written back on its own pages
+	pageSize = sysconf(_SC_PAGESIZE);
+	stateSize = size;
+	pageCount = (size + pageSize - 1) / pageSize;
+	stateOffset = stateStart(size, pageSize);
+	slotSize = (stateOffset + size + pageSize - 1) / pageSize * pageSize;
+	writtenSize = 2 * slotSize;
+	pageDirty.assign(pageCount, 0);
+	dirtyPages.reserve(pageCount);
+
+	// Not truncated, so a file being restarted from keeps its checkpoints until they are replaced
+	int fd = open(path, O_RDWR | O_CREAT, 0666);
+	if (fd == -1)
+		return -1;
+	if (ftruncate(fd, writtenSize) == -1)
+	{
+		close(fd);
+		return -1;
+	}
+	written = (char*)mmap(NULL, writtenSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (written == MAP_FAILED)
+	{
+		written = NULL;
+		return -1;
+	}
+
+	// Carry on from the newest checkpoint already in the file, if any, and write over the other slot first
+	uint64_t gen0 = slotGeneration(written, slotSize);
+	uint64_t gen1 = slotGeneration(written + slotSize, slotSize);
+	generation = gen0 > gen1 ? gen0 : gen1;
+	nextSlot = gen0 > gen1 ? 1 : 0;
+	return 0;
+}
+
+char* ckptSlot()
+{
+	return written + nextSlot * slotSize + stateOffset;
+}
+
+void ckptWrite(char* dst, const void* field, size_t n)
+{
+	// Compare a page at a time, so one changed value only dirties the page it is on
+	size_t offset = dst - ckptSlot();
+	const char* src = (const char*)field;
+	while (n > 0)
+	{
+		size_t page = offset / pageSize;
+		size_t len = (page + 1) * pageSize - offset;
+		if (len > n)
+			len = n;
+		if (memcmp(dst, src, len) != 0)
+		{
+			memcpy(dst, src, len);
+			if (!pageDirty[page])
+			{
+				pageDirty[page] = 1;
+				dirtyPages.push_back(page);
+			}
+		}
+		dst += len;
+		src += len;
+		offset += len;
+		n -= len;
+	}
+}
+
+void ckptCommit()
+{
+	char* slot = written + nextSlot * slotSize;
+	slotHeader* header = (slotHeader*)slot;
+	uint64_t* sums = (uint64_t*)(slot + sizeof(slotHeader));
+	char* state = slot + stateOffset;
+
+	// Checksum the pages that changed, or every page the first time this slot is committed
+	if (slotUnsummed[nextSlot])
+	{
+		for (size_t p = 0; p < pageCount; p++)
+			sums[p] = checksum(state + p * pageSize, p == pageCount - 1 ? stateSize - p * pageSize : pageSize);
+		slotUnsummed[nextSlot] = 0;
+	}
+	else
+	{
+		for (size_t i = 0; i < dirtyPages.size(); i++)
+		{
+			size_t p = dirtyPages[i];
+			sums[p] = checksum(state + p * pageSize, p == pageCount - 1 ? stateSize - p * pageSize : pageSize);
+		}
+	}
+	for (size_t i = 0; i < dirtyPages.size(); i++)
+		pageDirty[dirtyPages[i]] = 0;
+	dirtyPages.clear();
+
+	memcpy(header->magic, ckptMagic, sizeof(ckptMagic));
+	header->generation = ++generation;
+	header->size = stateSize;
+	header->pageSize = pageSize;
+	header->checksum = checksum((const char*)sums, pageCount * sizeof(uint64_t));
+	// Start writing the slot back without waiting for it. Only the pages written to above are dirty
+	msync(slot, slotSize, MS_ASYNC);
+	nextSlot = 1 - nextSlot;
+}
+
+int ckptLoad(const char* path, const char** state, size_t* size)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return -1;
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size == 0 || st.st_size % 2 != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	loadedSize = st.st_size;
+	loaded = (char*)mmap(NULL, loadedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (loaded == MAP_FAILED)
+	{
+		loaded = NULL;
+		return -1;
+	}
+
+	// Take the newest slot that is complete
+	size_t room = loadedSize / 2;
+	uint64_t gen0 = slotGeneration(loaded, room);
+	uint64_t gen1 = slotGeneration(loaded + room, room);
+	if (gen0 == 0 && gen1 == 0)
+	{
+		ckptClose();
+		return -1;
+	}
+	const char* slot = gen0 > gen1 ? loaded : loaded + room;
+	const slotHeader* header = (const slotHeader*)slot;
+	*state = slot + stateStart(header->size, header->pageSize);
+	*size = header->size;
+	return 0;
+}
+
+void ckptClose()
+{
+	if (written != NULL)
+	{
+		munmap(written, writtenSize);
+		written = NULL;
+	}
+	if (loaded != NULL)
+	{
+		munmap(loaded, loadedSize);
+		loaded = NULL;
+	}
+}
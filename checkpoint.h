@@ -0,0 +1,79 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+// Checkpoints
+// With -x, oss copies its whole state every so often into a memory-mapped file, and -X restarts from the newest
+// copy. The file holds two slots and each checkpoint goes in the one not holding the newest, with a checksum
+// and a generation number in its header, so a checkpoint cut short by a crash or reboot leaves the previous
+// one intact. A checkpoint only copies the bytes that differ from what its slot already holds, a page at a time,
+// and only the pages it changed get their checksum recomputed. The kernel writes those pages back in the
+// background, so the scheduler never waits for the disk
+
+// Cursor over a checkpoint's state. The same list of fields is walked to measure the state (buf is NULL), to
+// save it (loading is 0) and to load it (loading is 1), so saving and loading can never disagree on the layout
+typedef struct
+{
+	char* buf; // State being saved or loaded, NULL to only measure its size
+	size_t len; // Bytes walked so far
+	int loading; // Set to copy from buf into the fields instead of the other way
+} stateIO;
+
+// Function to copy n bytes of state at field to dst in the slot at ckptSlot(), only where they differ from
+// what the slot already holds
+void ckptWrite(char* dst, const void* field, size_t n);
+
+// Function to walk n bytes of state at field. Saving always goes to the slot at ckptSlot()
+static inline void stateBytes(stateIO* io, void* field, size_t n)
+{
+	if (io->buf != NULL && n > 0)
+	{
+		if (io->loading)
+			memcpy(field, io->buf + io->len, n);
+		else
+			ckptWrite(io->buf + io->len, field, n);
+	}
+	io->len += n;
+}
+
+// Function to walk n values of state starting at field
+template <typename T>
+static inline void stateArray(stateIO* io, T* field, size_t n)
+{
+	stateBytes(io, field, n * sizeof(T));
+}
+
+// Function to walk a vector holding at most cap values. Room for cap is always kept, so the state has the same
+// size however full the vector is
+template <typename T>
+static inline void stateVector(stateIO* io, std::vector<T>* v, size_t cap)
+{
+	long long n = v->size();
+	stateArray(io, &n, 1);
+	if (io->buf != NULL && io->loading)
+		v->resize(n);
+	stateArray(io, v->data(), io->buf != NULL ? n : 0);
+	io->len += (io->buf != NULL ? cap - n : cap) * sizeof(T);
+}
+
+// Function to create a checkpoint file, or reuse one, with room for two copies of size bytes of state
+// Returns 0 on success, -1 on failure
+int ckptOpen(const char* path, size_t size);
+
+// Function to get where the next checkpoint's state goes
+char* ckptSlot();
+
+// Function to finish the checkpoint written at ckptSlot(), making it the newest
+void ckptCommit();
+
+// Function to map a checkpoint file and find its newest complete checkpoint. Sets state and size to it
+// Returns 0 on success, -1 if the file has no usable checkpoint
+int ckptLoad(const char* path, const char** state, size_t* size);
+
+// Function to unmap the checkpoint files
+void ckptClose();
+
+#endif
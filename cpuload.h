@@ -0,0 +1,112 @@
+#ifndef CPULOAD_H
+#define CPULOAD_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Real work done by workers, set with -l in oss
+// By default a worker only draws how its quantum turns out and replies. With a load, it also does real work for
+// the part of the quantum it used, scaled down to real time, so workers compete for CPU and cache the way real
+// processes would. Work is counted in units rather than timed, so a worker that is preempted or misses in cache
+// takes longer in real time instead of doing less. oss measures how many units fit in a ms once, before any
+// worker starts, and hands that rate to every worker
+#define LOAD_NONE 0
+#define LOAD_SPIN 1 // Dependent integer arithmetic, stays in registers
+#define LOAD_MEM 2 // Pointer chase through a buffer much larger than a core's caches
+
+// Size of the buffer each worker chases through with LOAD_MEM
+#define LOAD_MEM_BYTES (16 * 1024 * 1024)
+// Chase steps per unit of LOAD_MEM work, and multiply-adds per unit of LOAD_SPIN work
+#define LOAD_UNIT 64
+
+// Names of the loads, in order, for options and printing
+static const char* const loadNames[] = {"none", "spin", "mem"};
+
+// One cache line of the chase buffer, pointing at the next line to visit
+typedef struct
+{
+	uint32_t next;
+	uint32_t pad[15];
+} loadLine;
+
+// Buffer used by LOAD_MEM, set up by loadInit
+static loadLine* loadChain = NULL;
+static uint32_t loadPos = 0;
+
+// Function to set up a load. For LOAD_MEM, links every line of a fresh buffer into one cycle in random order,
+// so each step of the chase is a cache miss the prefetcher can not predict. Uses its own generator so the
+// caller's rand() sequence is not disturbed
+static inline void loadInit(int kind)
+{
+	if (kind != LOAD_MEM || loadChain != NULL)
+		return;
+	uint32_t lines = LOAD_MEM_BYTES / sizeof(loadLine);
+	loadChain = (loadLine*)malloc(LOAD_MEM_BYTES);
+	for (uint32_t i = 0; i < lines; i++)
+		loadChain[i].next = i;
+	// Sattolo's shuffle, which always leaves a single cycle through every line
+	uint64_t state = 0x2545f4914f6cdd1dULL;
+	for (uint32_t i = lines - 1; i > 0; i--)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		uint32_t j = (uint32_t)(state % i);
+		uint32_t tmp = loadChain[i].next;
+		loadChain[i].next = loadChain[j].next;
+		loadChain[j].next = tmp;
+	}
+}
+
+// Function to free the LOAD_MEM buffer
+static inline void loadFree()
+{
+	free(loadChain);
+	loadChain = NULL;
+	loadPos = 0;
+}
+
+// Function to do units of work of the given kind
+static inline void loadRun(int kind, long long units)
+{
+	if (kind == LOAD_SPIN)
+	{
+		uint64_t x = 1;
+		for (long long i = 0; i < units * LOAD_UNIT; i++)
+			x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+		// Keep the result so the loop is not removed
+		__asm__ __volatile__("" : : "r"(x));
+	}
+	else if (kind == LOAD_MEM)
+	{
+		uint32_t pos = loadPos;
+		for (long long i = 0; i < units * LOAD_UNIT; i++)
+			pos = loadChain[pos].next;
+		loadPos = pos;
+	}
+}
+
+// Function to measure how many units of work of the given kind fit in one ms of real time, when nothing else
+// is running. Runs for about 50 ms
+static inline long long loadCalibrate(int kind)
+{
+	loadInit(kind);
+	// Warm up, touching the whole buffer once for LOAD_MEM
+	loadRun(kind, LOAD_MEM_BYTES / sizeof(loadLine) / LOAD_UNIT);
+
+	struct timespec start, now;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	long long units = 0;
+	long long elapsedNs = 0;
+	while (elapsedNs < 50000000)
+	{
+		loadRun(kind, 256);
+		units += 256;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsedNs = (long long)(now.tv_sec - start.tv_sec) * 1000000000 + (now.tv_nsec - start.tv_nsec);
+	}
+	return units * 1000000 / elapsedNs;
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <string.h>
+
+// Number of sub-buckets per power of two. Each recorded value lands in a bucket at most 1/16 (about 6%) wide
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+// Enough buckets for any non-negative 64 bit value
+#define HIST_BUCKETS (64 * HIST_SUB)
+
+// Fixed size log-linear histogram of ns values, in the style of an HDR histogram
+// Recording is a couple of shifts and an increment and never allocates, so it can sit on the dispatch path
+typedef struct
+{
+	long long counts[HIST_BUCKETS]; // Number of values recorded in each bucket
+	long long total; // Number of values recorded
+	long long sum; // Sum of values recorded, for the mean
+	long long max; // Largest value recorded
+} latencyHist;
+
+// Function to empty a histogram
+static inline void histInit(latencyHist* h)
+{
+	memset(h, 0, sizeof(latencyHist));
+}
+
+// Function to find the bucket a value belongs in
+// Values below HIST_SUB get their own bucket, larger ones keep their top HIST_SUB_BITS + 1 bits
+static inline int histBucket(long long v)
+{
+	if (v < HIST_SUB)
+		return v < 0 ? 0 : (int)v;
+	int msb = 63 - __builtin_clzll((unsigned long long)v);
+	int shift = msb - HIST_SUB_BITS;
+	return (shift + 1) * HIST_SUB + (int)((v >> shift) & (HIST_SUB - 1));
+}
+
+// Function to get the largest value that falls in a bucket
+static inline long long histBucketTop(int b)
+{
+	if (b < HIST_SUB)
+		return b;
+	int shift = b / HIST_SUB - 1;
+	long long base = (long long)(HIST_SUB + b % HIST_SUB) << shift;
+	return base + (1LL << shift) - 1;
+}
+
+// Function to add a value to a histogram
+static inline void histRecord(latencyHist* h, long long v)
+{
+	h->counts[histBucket(v)]++;
+	h->total++;
+	h->sum += v;
+	if (v > h->max)
+		h->max = v;
+}
+
+// Function to get the value at percentile p (0-100). Returns the top of the bucket holding it, never more than max
+static inline long long histPercentile(const latencyHist* h, double p)
+{
+	if (h->total == 0)
+		return 0;
+	// Rank of the value wanted, counting from 1
+	long long rank = (long long)(p / 100.0 * h->total + 0.5);
+	if (rank < 1)
+		rank = 1;
+	long long seen = 0;
+	for (int b = 0; b < HIST_BUCKETS; b++)
+	{
+		seen += h->counts[b];
+		if (seen >= rank)
+		{
+			long long top = histBucketTop(b);
+			return top < h->max ? top : h->max;
+		}
+	}
+	return h->max;
+}
+
+// Function to get the mean of the values recorded
+static inline long long histMean(const latencyHist* h)
+{
+	return h->total > 0 ? h->sum / h->total : 0;
+}
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef JOBMODEL_H
+#define JOBMODEL_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// How a job's quanta turn out
+// Shared by worker, which draws the outcome of each quantum oss sends it, and by oss's in-process mode (-I),
+// which draws them itself instead of forking workers. Both go through the functions below with the same seed,
+// so a job turns out the same either way
+
+// Workload mix a job is drawn from
+typedef struct
+{
+	int termPct; // Percent chance a quantum ends in termination
+	int blockPct; // Percent chance a quantum ends in blocking
+	long long runLimitNs; // Most CPU time a job may use before it terminates, 0 for no limit
+} jobMix;
+
+// One job's random stream and the CPU time it has used. Its random numbers are the same ones srand(seed) then
+// rand() would give, but each job has its own, so any number of jobs can be drawn from in one process
+// Holds pointers into itself, so it must not be copied or moved once started
+typedef struct
+{
+	struct random_data rng;
+	int32_t rngState[32]; // 128 bytes, the size of the state rand() uses
+	long long usedNs; // CPU time the job has used so far
+} jobState;
+
+// Function to start a new job with the given random seed
+static inline void jobStart(jobState* job, unsigned int seed)
+{
+	memset(&job->rng, 0, sizeof(job->rng));
+	initstate_r(seed, (char*)job->rngState, sizeof(job->rngState), &job->rng);
+	job->usedNs = 0;
+}
+
+// Function to get the job's next random number
+static inline int jobRand(jobState* job)
+{
+	int32_t r;
+	random_r(&job->rng, &r);
+	return r;
+}
+
+// Function to determine outcome of one time quantum
+// Returns 0 if job terminates, -1 if it blocks, 1 if it used the full quantum. Sets effQuantum to time used in ns
+static inline int jobQuantum(jobState* job, const jobMix* mix, int quantum, int* effQuantum)
+{
+	// Generate random number to determine job's outcome in this quantum
+	int outcome = jobRand(job) % 100;
+	// Stores what job's time quantum will be based on outcome generated. Initally set to full quantum
+	*effQuantum = quantum;
+	int status = 1;
+
+	// If less than termPct (20 by default), early termination
+	if (outcome < mix->termPct)
+	{
+		// If quantum is greater than 1, set effQuantum to random number less than full quantum
+		if (quantum > 1)
+			*effQuantum = jobRand(job) % quantum;
+		status = 0;
+	}
+	// Else outcome in the next blockPct (20-49 by default), simulate I/O interrupt
+	else if (outcome < mix->termPct + mix->blockPct)
+	{
+		if (quantum > 1)
+			*effQuantum = jobRand(job) % quantum;
+		status = -1;
+	}
+
+	// Job terminates once it has used all the CPU time it may, partway through the quantum that uses it up
+	if (mix->runLimitNs > 0 && job->usedNs + *effQuantum >= mix->runLimitNs)
+	{
+		*effQuantum = (int)(mix->runLimitNs - job->usedNs);
+		status = 0;
+	}
+	job->usedNs += *effQuantum;
+	return status;
+}
+
+#endif
@@ -0,0 +1,227 @@
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include "logger.h"
+
+// Size of ring buffer in bytes, must be a power of two
+#define LOG_RING_SIZE (4 * 1024 * 1024)
+// Longest line formatted on the stack, longer lines are formatted on the heap
+#define LOG_LINE_MAX 1024
+// How long the writer sleeps when the ring is empty before checking again, in ns
+#define LOG_IDLE_NS 1000000
+
+static char* ring = NULL; // Ring buffer of formatted log text
+static std::atomic<unsigned long long> head(0); // Total bytes ever added, only moved by the scheduler
+static std::atomic<unsigned long long> tail(0); // Total bytes ever written to the file, only moved by the writer
+static std::atomic<unsigned int> wakeSeq(0); // Futex word the writer sleeps on
+static std::atomic<int> stopping(0); // Set when the writer should drain the ring and exit
+static int logFd = -1; // Log file descriptor
+static int dropMode = 0; // Drop lines instead of waiting when the ring is full
+static long long dropped = 0; // Lines dropped because the ring was full
+static pthread_t writer; // Background writer thread
+static long long linesAdded = 0; // Lines added by logPrintf
+static long long bytesAdded = 0; // Bytes added to the ring
+static int timeCalls = 0; // Set to time calls to logPrintf and logWrite
+static long long callNs = 0; // Real time spent in logPrintf and logWrite
+
+// Function to read the monotonic clock in ns
+static long long monoNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Function to wake the writer thread
+static void wakeWriter()
+{
+	wakeSeq.fetch_add(1, std::memory_order_release);
+	syscall(SYS_futex, (unsigned int*)&wakeSeq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+// Function to write the bytes between tail and end to the file
+static void drainTo(unsigned long long end)
+{
+	unsigned long long pos = tail.load(std::memory_order_relaxed);
+	while (pos < end)
+	{
+		// Write up to the end of the ring in one call, the rest wraps to the start
+		size_t offset = pos & (LOG_RING_SIZE - 1);
+		size_t len = end - pos;
+		if (len > LOG_RING_SIZE - offset)
+			len = LOG_RING_SIZE - offset;
+		ssize_t n = write(logFd, ring + offset, len);
+		if (n <= 0)
+		{
+			if (n == -1 && errno == EINTR)
+				continue;
+			// File can not be written, throw the text away so the scheduler never stalls on it
+			n = len;
+		}
+		pos += n;
+		tail.store(pos, std::memory_order_release);
+	}
+}
+
+// Writer thread. Drains the ring, then sleeps until woken or LOG_IDLE_NS passes
+static void* writerMain(void*)
+{
+	struct timespec idle = {0, LOG_IDLE_NS};
+	while (true)
+	{
+		unsigned int seq = wakeSeq.load(std::memory_order_acquire);
+		unsigned long long end = head.load(std::memory_order_acquire);
+		if (end != tail.load(std::memory_order_relaxed))
+		{
+			drainTo(end);
+			continue;
+		}
+		if (stopping.load(std::memory_order_acquire))
+		{
+			// Catch anything added between reading head and seeing the stop request
+			drainTo(head.load(std::memory_order_acquire));
+			break;
+		}
+		syscall(SYS_futex, (unsigned int*)&wakeSeq, FUTEX_WAIT_PRIVATE, seq, &idle, NULL, 0);
+	}
+	return NULL;
+}
+
+int logOpen(const char* path, int dropWhenFull, int append)
+{
+	logFd = open(path, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0666);
+	if (logFd == -1)
+		return -1;
+	ring = (char*)malloc(LOG_RING_SIZE);
+	dropMode = dropWhenFull;
+
+	// Keep signals on the scheduler thread, so the SIGALRM handler never runs on the writer
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	if (pthread_create(&writer, NULL, writerMain, NULL) != 0)
+	{
+		perror("pthread_create failed");
+		exit(1);
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	return 0;
+}
+
+int logEnabled()
+{
+	return logFd != -1;
+}
+
+long long logDropped()
+{
+	return dropped;
+}
+
+void logTimeCalls()
+{
+	timeCalls = 1;
+}
+
+void logCounters(long long* lines, long long* bytes, long long* ns)
+{
+	*lines = linesAdded;
+	*bytes = bytesAdded;
+	*ns = callNs;
+}
+
+// Function to copy text into the ring, waiting for room or dropping it when the ring is full
+static void ringWrite(const char* text, size_t len)
+{
+	// Make sure there is room in the ring
+	unsigned long long pos = head.load(std::memory_order_relaxed);
+	if (len > LOG_RING_SIZE || pos + len - tail.load(std::memory_order_acquire) > LOG_RING_SIZE)
+	{
+		if (dropMode || len > LOG_RING_SIZE)
+		{
+			dropped++;
+			return;
+		}
+		// Wait for the writer to make room
+		wakeWriter();
+		while (pos + len - tail.load(std::memory_order_acquire) > LOG_RING_SIZE)
+			sched_yield();
+	}
+
+	// Copy text into ring, wrapping around the end if needed
+	size_t offset = pos & (LOG_RING_SIZE - 1);
+	size_t first = len < LOG_RING_SIZE - offset ? len : LOG_RING_SIZE - offset;
+	memcpy(ring + offset, text, first);
+	memcpy(ring, text + first, len - first);
+	head.store(pos + len, std::memory_order_release);
+	bytesAdded += len;
+
+	// Only wake the writer early once the ring is half full, otherwise it picks the text up on its next pass
+	if (pos + len - tail.load(std::memory_order_relaxed) > LOG_RING_SIZE / 2)
+		wakeWriter();
+}
+
+void logPrintf(const char* fmt, ...)
+{
+	if (logFd == -1)
+		return;
+	long long startNs = timeCalls ? monoNs() : 0;
+
+	// Format line on the stack, falling back to the heap for unusually long lines
+	char buf[LOG_LINE_MAX];
+	char* line = buf;
+	va_list args;
+	va_start(args, fmt);
+	int len = vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	if (len < 0)
+		return;
+	linesAdded++;
+	if (len >= (int)sizeof(buf))
+	{
+		line = (char*)malloc(len + 1);
+		va_start(args, fmt);
+		vsnprintf(line, len + 1, fmt, args);
+		va_end(args);
+	}
+
+	ringWrite(line, len);
+	if (line != buf)
+		free(line);
+	if (timeCalls)
+		callNs += monoNs() - startNs;
+}
+
+void logWrite(const char* text, size_t len)
+{
+	if (logFd == -1)
+		return;
+	long long startNs = timeCalls ? monoNs() : 0;
+	ringWrite(text, len);
+	if (timeCalls)
+		callNs += monoNs() - startNs;
+}
+
+void logClose()
+{
+	if (logFd == -1)
+		return;
+	stopping.store(1, std::memory_order_release);
+	wakeWriter();
+	pthread_join(writer, NULL);
+	close(logFd);
+	logFd = -1;
+	free(ring);
+	ring = NULL;
+}
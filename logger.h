@@ -0,0 +1,38 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stddef.h>
+
+// Asynchronous log file writer
+// The scheduler formats each line on the stack, copies it into a lock-free ring buffer and carries on, a
+// background thread drains the ring to the file. Only one thread (the scheduler) may call logPrintf
+
+// Function to open the log file and start the writer thread
+// If dropWhenFull is set, lines that do not fit in a full ring are dropped, otherwise the caller waits for room
+// If append is set, lines are added after what the file already holds instead of replacing it
+// Returns 0 on success, -1 if the file could not be opened
+int logOpen(const char* path, int dropWhenFull, int append);
+
+// Function to add a formatted line to the log. Does nothing if the log is not open
+void logPrintf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// Function to add already formatted text of length len to the log. Does nothing if the log is not open
+void logWrite(const char* text, size_t len);
+
+// Function to write everything still in the ring, stop the writer thread and close the file
+void logClose();
+
+// Function to check if the log is open, so callers can skip building log-only text
+int logEnabled();
+
+// Function to get how many lines were dropped because the ring was full
+long long logDropped();
+
+// Function to start timing how long callers spend adding to the log, reported by logCounters
+void logTimeCalls();
+
+// Function to get how many lines and bytes have been added to the log, and the ns spent adding them (0 unless
+// logTimeCalls was called)
+void logCounters(long long* lines, long long* bytes, long long* ns);
+
+#endif
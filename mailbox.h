@@ -0,0 +1,94 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <atomic>
+
+// Size of a cache line. Each mailbox is padded to a multiple of this so two slots never share a line
+#define CACHE_LINE 64
+
+// Number of times a waiter polls its mailbox before sleeping in the kernel (only used on multi-core hosts)
+#define MB_SPIN 2000
+
+// Header at the start of the mailbox segment, shared by all slots
+// Workers bump replySeq after every reply so oss can wait for whichever in-flight worker answers first
+typedef struct alignas(CACHE_LINE)
+{
+	std::atomic<uint32_t> replySeq; // Incremented by any worker each time a reply is posted
+	std::atomic<uint32_t> ossSleeping; // Set while oss sleeps on replySeq
+} mailboxHeader;
+
+// Mailbox used by the shared-memory transport, one per process table slot, following the header
+// oss posts a quantum and bumps dispatchSeq, worker posts its status and used ns and bumps replySeq
+typedef struct alignas(CACHE_LINE)
+{
+	std::atomic<uint32_t> dispatchSeq; // Incremented by oss each time a new quantum is posted
+	std::atomic<uint32_t> replySeq; // Incremented by worker each time a reply is posted
+	std::atomic<uint32_t> workerSleeping; // Set while worker sleeps on dispatchSeq
+	int quantum; // Time quantum given to worker in ns, -1 tells a pool worker to exit
+	int grant; // Most quanta worker may run back to back before replying
+	int newJob; // Set by oss before the first dispatch of a new job to a pool worker
+	unsigned int seed; // Random seed for the new job
+	int status; // Worker reply: 0 (terminated), 1 (used full quantum) or -1 (blocked)
+	int used; // Amount of quantum used by worker in ns
+	int runs; // Quanta run from the grant, every one but the last used in full
+	int scripted; // Set by oss when replaying a trace, worker replies with scriptStatus and scriptUsed instead of drawing them
+	int scriptStatus;
+	int scriptUsed;
+} mailbox;
+
+// Function to hint to the CPU that this is a spin loop
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+// Function to sleep on a futex word while it still holds val
+static inline void futexWait(std::atomic<uint32_t>* word, uint32_t val)
+{
+	// Mailboxes live in SysV shared memory mapped by several processes, so a shared (non-private) futex is used
+	syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, val, NULL, NULL, 0);
+}
+
+// Function to wake one process sleeping on a futex word
+static inline void futexWake(std::atomic<uint32_t>* word)
+{
+	syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+// Function to wait until seq moves past last. Polls up to spin times, then sleeps on the futex
+// Returns the new sequence value
+static inline uint32_t mbWait(std::atomic<uint32_t>* seq, std::atomic<uint32_t>* sleeping, uint32_t last, int spin)
+{
+	uint32_t val;
+	// Poll first, a reply is usually only a few microseconds away on a multi-core host
+	for (int i = 0; i < spin; i++)
+	{
+		val = seq->load(std::memory_order_acquire);
+		if (val != last)
+			return val;
+		cpuRelax();
+	}
+
+	// Announce that this side is about to sleep, then recheck before every sleep so a post is never missed
+	sleeping->store(1, std::memory_order_seq_cst);
+	while ((val = seq->load(std::memory_order_seq_cst)) == last)
+		futexWait(seq, last);
+	sleeping->store(0, std::memory_order_relaxed);
+	return val;
+}
+
+// Function to publish a new sequence value and wake the other side only if it is sleeping
+static inline void mbPost(std::atomic<uint32_t>* seq, std::atomic<uint32_t>* sleeping)
+{
+	seq->fetch_add(1, std::memory_order_seq_cst);
+	if (sleeping->load(std::memory_order_seq_cst))
+		futexWake(seq);
+}
+
+#endif
@@ -3,6 +3,10 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <sys/msg.h>
+#include <sys/resource.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sched.h>
 #include <cstring>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,26 +15,47 @@
 #include <signal.h>
 #include <time.h>
 #include <string>
-#include <queue>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "mailbox.h"
+#include "slotmap.h"
+#include "simclock.h"
+#include "logger.h"
+#include "histogram.h"
+#include "trace.h"
+#include "policy.h"
+#include "ossstats.h"
+#include "cpuload.h"
+#include "checkpoint.h"
+#include "jobmodel.h"
 
 #define PERMS 0644
 
 using namespace std;
 
-// Structure for Process Control Block
-typedef struct 
-{
-	int occupied; // Either true or false
-	pid_t pid; // Process ID of this child
-	int startSeconds; // Time when it was forked
-	int startNano; // Time when it was forked
-	int messagesSent; // Total times oss sent a message to it
-	int serviceTimeSeconds; // Total CPU service time in sec
-	int serviceTimeNano; // Total CPU service time in ns
-	int eventWaitSec; // Total wait time in sec
-	int eventWaitNano; // Total wait time in ns
-	int blocked; // Indicates if process is blocked
-} PCB;
+// Process control block table, one array per field indexed by table slot, so a pass over the table only touches
+// the fields it reads. Simulated times are whole ns, so none of them need normalizing
+typedef struct
+{
+	int* occupied; // Either true or false
+	pid_t* pid; // Process ID of this child
+	long long* startNs; // Time when it was forked in ns
+	int* messagesSent; // Total times oss sent a message to it
+	long long* serviceNs; // Total CPU service time in ns
+	long long* eventWaitNs; // Time process's current block ends in ns
+	long long* blockStartNs; // Time process's current block started in ns
+	int* blocked; // Indicates if process is blocked
+	long long* launchRealNs; // Real time spent launching this job, until its first reply is added
+	int* level; // Ready queue level process was last dispatched from
+	long long* dispatchRealNs; // Real time of last dispatch, used to measure round trip
+	int* job; // Job number, counting spawns from 0, used to look up the job's decisions in a trace
+	int* dispatchQuantum; // Quantum given in the last dispatch in ns
+	long long* readyNs; // Time process last became ready in ns
+	long long* blockedNs; // Total time process has been blocked in ns
+	int* exited; // Set once the worker running this job has been seen to exit
+	int* cpu; // With -M, CPU whose ready queues the process is in, or that last ran it
+} pcbTable;
 
 // Message buffer for communication between OSS and child processes
 typedef struct msgbuffer 
@@ -41,26 +66,253 @@ typedef struct msgbuffer
 } msgbuffer;
 
 // Global variables
-PCB* processTable; // Process control block table to track child processes
+pcbTable processTable; // Process control block table to track child processes
 
-int *shm_ptr; // Shared memory pointer to store system clock
+simClock* sysClock; // Shared memory pointer to store system clock
 int shm_id; // Shared memory ID
 
-int msqid; // Queue ID for communication
-
-FILE* logfile = NULL; // Pointer to logfile
+int msqid; // Queue ID for communication from oss to workers
+int rmsqid = -1; // Queue ID for replies from workers to oss, kept separate so oss can receive a reply of any type
+
+// Logging to ossLog.txt, enabled with -f. Lines go through the asynchronous writer in logger.cpp
+int logToFile = 0;
+int dropLog = 0; // Set with -d to drop log lines instead of waiting when the log buffer is full
+
+// Number of entries in process table, which is also the max amount of simultaneous processes (-s)
+int tableSize = 18;
+// Total amount of processes to launch (-n)
+int maxTotal = 100;
+// Seconds of real time before everything is terminated, 0 for no limit (-a)
+int realTimeLimit = 3;
+
+// Occupied entries of process table, used to find a free entry and to walk only occupied ones
+slotMap slots;
+
+// Shared-memory mailbox transport, selected with -m. Message queue is used otherwise
+int useMailbox = 0; // Set to 1 to dispatch through mailboxes instead of msgsnd/msgrcv
+mailbox* mailboxes = NULL; // Shared memory mailboxes, one per process table slot
+mailboxHeader* mbHeader = NULL; // Header of mailbox shared memory
+int mb_id = -1; // Shared memory ID of mailboxes, -1 when they are not used
+int mbSpin = 0; // Amount of times oss polls a mailbox before sleeping on its futex
+
+// Number of simulated CPUs, set with -c. Up to this many workers are dispatched and in flight at once
+int cpus = 1;
+int* inFlight = NULL; // Table indices of workers that have been dispatched but have not replied
+int inFlightCount = 0;
+
+// Multiprocessor model, set with -M. Each of the cpus simulated CPUs has its own copy of the policy, and so its own
+// ready queues, and runs one process at a time, all of them at once. Instead of ticking, the clock jumps to the
+// next event: the earliest end of a run, a spawn, an unblock or a status print. New and unblocked processes are
+// placed on a CPU by placeNew and placeWake. A CPU with nothing ready steals the next process of the CPU with the
+// most ready, unless stealing is turned off
+#define PLACE_LEAST 0 // CPU with the fewest processes ready or running
+#define PLACE_RR 1 // Each CPU in turn
+#define PLACE_HOME 2 // CPU that last ran the process, only for unblocked processes
+const char* const placeNames[] = {"least", "rr", "home"};
+int cpuModel = 0;
+int placeNew = PLACE_LEAST;
+int placeWake = PLACE_HOME;
+int cpuSteal = 1;
+int placeNext = 0; // Next CPU to place on with PLACE_RR
+
+// State and statistics of one simulated CPU in the multiprocessor model
+typedef struct
+{
+	int running; // Table index of process being run, -1 if idle
+	int ready; // Number of processes in this CPU's ready queues
+	long long startNs; // Time current run started
+	long long endNs; // Time current run ends, known once its worker has replied
+	int status; // How current run ended, as the worker replied
+	int used; // ns of quantum current run used
+	long long idleSinceNs; // Time CPU last went idle
+	long long busyNs; // Total time spent running processes
+	long long idleNs; // Total time spent with nothing to run
+	long long dispatches; // Runs dispatched on this CPU
+	long long steals; // Processes this CPU took from another CPU's ready queues
+} simCpu;
+simCpu* simCpus = NULL;
+
+// Batched quantum grants, set with -g. When the policy will keep giving a process the same quantum, it is granted
+// up to grantMax quanta in one message. The worker runs them back to back until it blocks or terminates and
+// replies once with how many it ran and how the last one ended. The rest are handed to the main loop one per
+// dispatch without any message, so the schedule is the same as when every quantum is sent on its own
+int grantMax = 1;
+int* batchLeft = NULL; // Quanta from each slot's last grant not yet handed to the main loop
+int* batchStatus = NULL; // How the last quantum of each slot's grant ended
+int* batchUsed = NULL; // ns used of the last quantum of each slot's grant
+int* batchQuantum = NULL; // Quantum each slot's grant was given with
+long long grantsSent = 0; // Grants actually sent to workers
+long long grantQuanta = 0; // Quanta handed to the main loop from a grant already answered, without any message
+// Values of a slot's dispatchRealNs for a dispatch that sent no message, and so has no round trip
+#define DISPATCH_FROM_GRANT -1 // Quantum left from the process's last grant
+#define DISPATCH_WORKER_GONE -2 // Worker had already exited
+
+// What sendQuantum did with a quantum
+#define SEND_FAILED -1 // Message could not be sent
+#define SEND_OK 0 // Sent, or handed out from a grant or run in oss
+#define SEND_GONE 1 // Worker has exited, so nothing was sent
+
+// Discrete-event clock mode, set with -e. When idle, the clock jumps straight to the next event instead of ticking
+int eventMode = 0;
+
+// Pre-forked worker pool, set with -p. One long-lived worker per table entry runs job after job
+int usePool = 0;
+pid_t* poolPids = NULL; // PID of the pooled worker that belongs to each table entry
+
+// In-process jobs, set with -I. No worker is forked and no message is sent: oss draws each quantum's outcome
+// itself with the same code and seeds as a pooled worker, so the simulation is the same, only faster
+int inProcess = 0;
+jobState* inJobs = NULL; // Job running in each table entry
+jobMix inMix; // Workload mix jobs are drawn from
+
+// Seed of job number job's random numbers with -p and -I, from -z or oss's PID
+unsigned int jobSeedBase = 0;
+
+// Worker lifecycle. Every worker's pidfd is registered in lifeEpoll, and SIGCHLD wakes oss wherever it is waiting
+// for a reply, so a worker that exits is noticed at once and reaped with any others that exited alongside it,
+// without oss ever waiting on one worker. Workers share one process group so teardown is a single kill
+int lifeEpoll = -1;
+pid_t workerPgid = 0; // Process group of every worker, led by the first one launched
+// Worker being watched, found from its epoll event by index so reaping it only touches its own table entry
+typedef struct
+{
+	int pidfd; // pidfd registered in lifeEpoll
+	int slot; // Table index the worker was launched for
+} workerWatch;
+vector<workerWatch> watches; // Watched workers, entries are reused once their worker is reaped
+vector<int> freeWatches; // Indices of unused entries in watches
+volatile sig_atomic_t exitPending = 0; // Set by the SIGCHLD handler until oss reaps
+volatile sig_atomic_t stopSignal = 0; // Signal that asked oss to terminate everything, 0 if none has
+long long crashedWorkers = 0; // Workers that exited without replying to a quantum
+// Reply type used to wake oss from msgrcv, never the PID of a worker
+#define WAKE_MTYPE 1
+
+// Variables to measure real time spent in dispatch round trips for each transport
+long long dispatchWallNs = 0;
+long long dispatchCount = 0;
+
+// Variables to measure real time spent launching jobs (fork or pool hand-off, plus first round trip)
+long long totalLaunchNs = 0;
+long long launchedJobs = 0;
+
+// Benchmark mode, set with -b. Prints one machine-readable line of real-time measurements at exit
+int benchMode = 0;
+latencyHist dispatchHist; // Real time of each dispatch round trip in ns
+latencyHist launchHist; // Real time of each job launch in ns
+latencyHist tickHist; // Real time of each scheduler tick's blocked queue scan in ns
+
+// Live statistics segment, published with -S for ossstat to read
+ossStats* stats = NULL;
+int stats_id = -1;
+long long phaseMarkNs = 0; // Real time the current main loop phase started
+long long statsPublishNs = 0; // Real time slow-moving statistics were last copied to the segment
+
+// Workload trace recorded with -r or replayed with -R
+const char* recordPath = NULL;
+const char* replayPath = NULL;
+
+// Checkpoints written with -x F[:ms] and restarted from with -X F
+const char* ckptPath = NULL;
+const char* restartPath = NULL;
+long long ckptIntervalNs = 1000000000; // Real time between checkpoints in ns
+long long nextCkptNs = 0; // Real time next checkpoint is due
+long long checkpoints = 0; // Checkpoints written
+const char* restartState = NULL; // State loaded from the checkpoint being restarted from
+size_t restartSize = 0;
+// State of oss's rand(), kept here instead of inside the C library so it can be checkpointed
+char randState[128];
+
+// Real work done by workers, set with -l kind[:D]. A worker does real work for 1/D of the simulated time it uses
+int loadKind = LOAD_NONE;
+int loadDiv = 100;
+long long loadUnitsPerSec = 0; // Units of work per simulated second, measured before any worker starts
+
+// CPU affinity. oss is pinned to ossCpu with -o, and the worker of table index i to workerCpus[i % workerCpuCount] with -k
+int ossCpu = -1;
+int* workerCpus = NULL;
+int workerCpuCount = 0;
+
+// Workload mix handed to workers with -w: percent chance a quantum ends in termination, and in blocking
+int termPct = 20;
+int blockPct = 30;
+// Most CPU time a job may use before it terminates, set with -t T in seconds, 0 for no limit
+long long runLimitNs = 0;
+// Least simulated time between two spawns, set with -i I in ns
+long long minSpawnGapNs = 0;
+
+// Entry in blocked queue. Ordered by time process is due to unblock, ties broken by order it was blocked
+typedef struct blockedEntry
+{
+	long long wakeNs; // Time process is due to unblock in ns
+	long long seq; // Order in which process was blocked
+	int indx; // Process table index
+	bool operator>(const blockedEntry& other) const
+	{
+		if (wakeNs != other.wakeNs)
+			return wakeNs > other.wakeNs;
+		return seq > other.seq;
+	}
+} blockedEntry;
 
-// Priority queues for scheduling
-queue<int> rQueue0;
-queue<int> rQueue1;
-queue<int> rQueue2;
-queue<int> blockedQueue;
+// Blocked processes kept in a min-heap by wake up time, so each tick only touches processes that are due
+// A plain vector kept as a heap, so it can be saved in a checkpoint and loaded back as is
+vector<blockedEntry> blockedQueue;
+vector<blockedEntry> dueBlocked; // Reused buffer of processes that are due to unblock this tick
+long long blockedSeq = 0; // Increments each time a process is blocked
 
-// Time quantums for each priority queue in ns
+// Base time quantum in ns
 const int baseq = 10000000;
-const int q0 = baseq;
-const int q1 = 2 * baseq;
-const int q2 = 4 * baseq;
+
+// Max number of sec allowed between spawning processes
+const int maxBetProcSec = 1;
+// Max number of ns allowed between spawning processes
+const int maxBetProcNs = 1000;
+
+// MLFQ queues and the time quantum of each in ns, set with -L. Defaults to q0 = baseq, q1 = 2 * baseq and q2 = 4 * baseq
+int numLevels = 3;
+int levelQuanta[MAX_LEVELS] = {baseq, 2 * baseq, 4 * baseq};
+int levelsGiven = 0; // Set when -L is given
+
+// Percent of runs from each MLFQ queue that should end within their quantum, set with -A. 0 keeps quanta fixed
+int adaptPct = 0;
+quantumTuner tuner; // Retunes the quanta when adaptPct is set
+
+// Scheduling policy, set with -P. policyParam is the number after the name, if any
+#define POLICY_MLFQ 0
+#define POLICY_BOOST 1
+#define POLICY_LOTTERY 2
+#define POLICY_STRIDE 3
+#define POLICY_CFS 4
+int policyKind = POLICY_MLFQ;
+int policyParam = 0;
+
+// Values to keep track of child iterations
+int total = 0; // Total amount of processes
+int running = 0;
+int msgsnt = 0;
+
+// Preformatted status print text of one process table entry
+typedef struct
+{
+	char line[64]; // Process table line
+	int lineLen;
+	char token[48]; // Entry shown in a priority queue
+	int tokenLen;
+} slotText;
+
+// Status print buffers, sized once for a full table so printing never allocates
+slotText* slotTexts = NULL; // Cached text for each table entry, filled in when a process is spawned
+char* tableText = NULL; // Process table section of the report, the lines of occupied entries in index order
+char* tableSpare = NULL; // Buffer the next process table section is patched into, then swapped with tableText
+int tableTextLen = 0;
+int* tableLineLen = NULL; // Length of each entry's line in tableText, 0 if it has none
+int* tableLenTree = NULL; // Fenwick tree over tableLineLen, gives where each entry's line starts in tableText
+int* changedSlots = NULL; // Entries spawned or terminated since the last print, each listed once
+char* slotChanged = NULL; // Set for an entry while it is in changedSlots
+int changedCount = 0;
+char* snapBuf = NULL; // Whole report
+int snapCap = 0;
+int snapLen = 0;
 
 // Variables to track statistics
 long long totalTurnaroundTimeNs = 0; 
@@ -69,46 +321,53 @@ long long totalIdleTimeNs = 0;
 long long totalServiceTimeNs = 0;
 long long totalBlockedTimeNs = 0;
 
+// Distributions of simulated times, recorded per process (response, turnaround, wait, blocked) and per dispatch
+// (time waiting in a ready queue). Each has one histogram for all queues followed by one per queue, so memory
+// does not grow with the number of jobs
+#define METRIC_RESPONSE 0 // From spawn to first dispatch
+#define METRIC_TURNAROUND 1 // From spawn to termination
+#define METRIC_WAIT 2 // Turnaround less service time, as in the averages
+#define METRIC_BLOCKED 3 // Total time blocked
+#define METRIC_QUEUE_WAIT 4 // Time in a ready queue before each dispatch
+#define METRICS 5
+const char* const metricNames[METRICS] = {"response", "turnaround", "wait", "blocked", "queue wait"};
+latencyHist* metricHists = NULL; // METRICS rows of readyLevels + 1 histograms
+int histAtPrint = 0; // Set with -H to add the distributions to every status print
+
 // Variables to hold amount of additons to queue
-int q0Count = 0;
-int q1Count = 0;
-int q2Count = 0;
+int readyLevels = 0; // Number of ready queues the policy has
+int queueCount[MAX_LEVELS] = {0};
 int blockedCount = 0;
 
-// Function to increment system clock in seconds and nanoseconds
+// Function to increment system clock by one 10 ms tick
 void incrementClock()
 {
-	// Update nanoseconds and check for overflow
-	shm_ptr[1] += 10000000;
-	if (shm_ptr[1] >= 1000000000) // Determines if nanosec is gt 1 billion, meaning it should convert to 1 second
-	{
-		shm_ptr[1] -= 1000000000;
-		shm_ptr[0]++;
-	}
-
+	clockAdvance(sysClock, 10000000);
 }
 
 // Function to add a small overhead of 1000 ns to the clock (less amount than incrmenting clock)
 void addOverhead()
 {
-	// Increment ns in shared memor
-	shm_ptr[1] += 1000;
-	// Check for overflow
-	if (shm_ptr[1] >= 1000000000)
-	{
-		shm_ptr[1] -= 1000000000;
-		shm_ptr[0]++;
-	}
+	clockAdvance(sysClock, 1000);
+}
+
+// Function to find how many whole idle iterations can be skipped before an event of time eventNs is seen
+// An idle iteration adds 10 ms at the top of the loop and 10 ms when idle, so after skipping n iterations
+// the next loop iteration checks for events at nowNs + 20 ms * n + 10 ms
+long long idleItersBefore(long long nowNs, long long eventNs)
+{
+	long long gap = eventNs - nowNs - 10000000;
+	if (gap <= 0)
+		return 0;
+	return (gap + 20000000 - 1) / 20000000;
 }
 
 // Function to access and add to shared memory
 void shareMem()
 {
-	// Generate key
-	const int sh_key = ftok("main.c", 0);
-	// Create shared memory
-	shm_id = shmget(sh_key, sizeof(int) * 2, IPC_CREAT | 0666);
-	if (shm_id <= 0) // Check if shared memory get failed
+	// Create shared memory private to this run, workers are given its ID
+	shm_id = shmget(IPC_PRIVATE, sizeof(simClock), IPC_CREAT | 0600);
+	if (shm_id == -1) // Check if shared memory get failed
 	{
 		// If true, print error message and exit
 		fprintf(stderr, "Shared memory get failed\n");
@@ -116,116 +375,438 @@ void shareMem()
 	}
 	
 	// Attach shared memory
-	shm_ptr = (int*)shmat(shm_id, 0, 0);
-	if (shm_ptr <= 0)
+	sysClock = (simClock*)shmat(shm_id, 0, 0);
+	if (sysClock == (simClock*)-1)
 	{
 		fprintf(stderr, "Shared memory attach failed\n");
 		exit(1);
 	}
-	// Initialize shared memory pointers to represent clock
-	// Index 0 represents seconds, index 1 represents nanoseconds
-	shm_ptr[0] = 0;
-	shm_ptr[1] = 0;
+	// Initialize clock to 0 ns
+	sysClock->ns.store(0);
 }
 
-// FUnction to print formatted process table and contents of the three different priority queues
-void printInfo(int n)
+// Function to create and attach mailbox shared memory, one mailbox per process table slot
+void mailboxMem()
 {
-	
-	// Print to console
-	printf("OSS PID: %d SysClockS: %u SysClockNano: %u\n Process Table:\n", getpid(), shm_ptr[0], shm_ptr[1]);
-	printf("Entry\tOccupied\tPID\tStartS\tStartNs\n");
-	
-	// Print to log file as well
-	fprintf(logfile, "OSS PID: %d SysClockS: %u SysClockNano: %u\n Process Table:\n", getpid(), shm_ptr[0], shm_ptr[1]);
-	fprintf(logfile,"Entry\tOccupied\tPID\tStartS\tStartNs\n");
+	// Create shared memory private to this run, workers are given its ID
+	mb_id = shmget(IPC_PRIVATE, sizeof(mailboxHeader) + sizeof(mailbox) * tableSize, IPC_CREAT | 0600);
+	if (mb_id == -1)
+	{
+		fprintf(stderr, "Mailbox shared memory get failed\n");
+		exit(1);
+	}
 
-	for (int i = 0; i < n; i++)
+	// Attach shared memory. Segments are page aligned, so every mailbox starts on its own cache line
+	mbHeader = (mailboxHeader*)shmat(mb_id, 0, 0);
+	if (mbHeader == (mailboxHeader*)-1)
 	{
-		// Print table only if occupied by process
-		if (processTable[i].occupied == 1)
-		{
-			printf("%d\t%d\t\t%d\t%u\t%u\n", i, processTable[i].occupied, processTable[i].pid, processTable[i].startSeconds, processTable[i].startNano);
-			fprintf(logfile, "%d\t%d\t\t%d\t%u\t%u\n", i, processTable[i].occupied, processTable[i].pid, processTable[i].startSeconds, processTable[i].startNano);
-		}
+		fprintf(stderr, "Mailbox shared memory attach failed\n");
+		exit(1);
 	}
-	printf("\n");
-	fprintf(logfile, "\n");
-	
+	mbHeader->replySeq.store(0);
+	mbHeader->ossSleeping.store(0);
+	// Mailboxes follow the header
+	mailboxes = (mailbox*)(mbHeader + 1);
+
+	// Only spin before sleeping if there is another core for the worker to run on
+	if (sysconf(_SC_NPROCESSORS_ONLN) > 1)
+		mbSpin = MB_SPIN;
+}
 
-	
-	// Create temporary queues to print contents of priority queues
-	queue<int> temp0 = rQueue0;
-	queue<int> temp1 = rQueue1;
-	queue<int> temp2 = rQueue2;
-
-	printf("----MLFQ State----\n");
-	fprintf (logfile, "-----MLFQ State----\n");
-
-	// Incrementally print each queue's contents
-	// Queue 0
-	printf("Queue 0: ");
-	fprintf(logfile, "Queue 0: ");
-	while(!temp0.empty())
-	{
-		int i = temp0.front();
-		temp0.pop();
-		printf("[Table Index: %d; PID: %d] ", i, processTable[i].pid);
-		fprintf(logfile, "[Table Index: %d; PID: %d] ", i, processTable[i].pid);
-	}
-	printf("\n");
-	fprintf(logfile, "\n");
-	
-	// Queue 1
-	printf("Queue 1: ");
-	fprintf(logfile, "Queue 1: ");
+// Function to reset a mailbox before a new worker is forked into its slot
+void resetMailbox(int indx)
+{
+	mailboxes[indx].dispatchSeq.store(0);
+	mailboxes[indx].replySeq.store(0);
+	mailboxes[indx].workerSleeping.store(0);
+	mailboxes[indx].quantum = 0;
+	mailboxes[indx].grant = 1;
+	mailboxes[indx].runs = 1;
+	mailboxes[indx].status = 0;
+	mailboxes[indx].used = 0;
+}
 
-	while(!temp1.empty())
+// Function to remove the message queue and the reply queue. Each is removed even if the other can not be
+// Returns 0 on success, -1 if either could not be removed
+int removeQueues()
+{
+	int rc = 0;
+	if (msgctl(msqid, IPC_RMID, NULL) == -1)
+	{
+		perror("msgctl failed to remove message queue");
+		rc = -1;
+	}
+	if (msgctl(rmsqid, IPC_RMID, NULL) == -1)
 	{
-		int i = temp1.front();
-		temp1.pop();
-		printf("[Table Index: %d; PID: %d] ", i, processTable[i].pid);
-		fprintf(logfile, "[Table Index: %d; PID: %d] ", i, processTable[i].pid);
+		perror("msgctl failed to remove reply queue");
+		rc = -1;
 	}
-	printf("\n");
-	fprintf(logfile, "\n");
+	return rc;
+}
 
-	// Queue 2
-	printf("Queue 2: ");
-	fprintf(logfile, "Queue 2: ");
-	while (!temp2.empty())
+// Function to detach and remove mailbox shared memory if it was created
+void removeMailboxes()
+{
+	if (mbHeader == NULL)
+		return;
+	if (shmdt(mbHeader) == -1)
+	{
+		perror("shmdt failed");
+		exit(1);
+	}
+	if (shmctl(mb_id, IPC_RMID, NULL) == -1)
 	{
-		int i = temp2.front();
-		temp2.pop();
-		printf("[Table Index: %d; PID: %d] ", i, processTable[i].pid);
-		fprintf(logfile, "[Table Index: %d; PID: %d] ", i, processTable[i].pid);
+		perror("shmctl failed");
+		exit(1);
 	}
-	printf("\n");
-	fprintf(logfile, "\n");
+	mbHeader = NULL;
+	mailboxes = NULL;
+}
+
+// Function to return current real (monotonic) time in ns
+long long realTimeNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-	printf("------------------\n\n\n");
-	fprintf(logfile, "------------------\n\n\n");
+// Function to copy counters oss already keeps into the statistics segment
+void statsPublish()
+{
+	statSet(&stats->spawned, total);
+	statSet(&stats->terminated, terminatedProcesses);
+	statSet(&stats->dispatches, msgsnt);
+	statSet(&stats->blocked, blockedCount);
+	statSet(&stats->running, running);
+	statSet(&stats->simNs, clockNow(sysClock));
+	long long lines, bytes, ns;
+	logCounters(&lines, &bytes, &ns);
+	statSet(&stats->logLines, lines);
+	statSet(&stats->logBytes, bytes);
+	statSet(&stats->logNs, ns);
+}
 
+// Function to end a phase of the main loop, billing the real time since the last phase ended to it
+// Every 10 ms of real time also publishes the counters, so the hot path never writes them itself
+void statPhase(int phase)
+{
+	if (stats == NULL)
+		return;
+	long long nowNs = realTimeNs();
+	statAdd(&stats->phaseNs[phase], nowNs - phaseMarkNs);
+	statAdd(&stats->phaseCount[phase], 1);
+	phaseMarkNs = nowNs;
+
+	if (nowNs - statsPublishNs >= 10000000)
+	{
+		statsPublish();
+		statsPublishNs = nowNs;
+	}
 }
 
-// Signal handler to terminate all processes after 3 seconds in real time
-void signal_handler(int sig)
+// Function to create and attach the live statistics segment
+void statsMem()
+{
+	// Create a segment private to this run. ossstat is pointed at it by its ID, so it is readable by the user's
+	// other processes
+	stats_id = shmget(IPC_PRIVATE, sizeof(ossStats), IPC_CREAT | 0644);
+	if (stats_id == -1)
+	{
+		fprintf(stderr, "Statistics shared memory get failed\n");
+		exit(1);
+	}
+	stats = (ossStats*)shmat(stats_id, 0, 0);
+	if (stats == (ossStats*)-1)
+	{
+		fprintf(stderr, "Statistics shared memory attach failed\n");
+		exit(1);
+	}
+	// Mark segment as ready
+	memset((void*)stats, 0, sizeof(ossStats));
+	stats->ossPid.store(getpid());
+	stats->magic = STATS_MAGIC;
+	printf("Live statistics published, read them with: ./ossstat -s %d\n", stats_id);
+}
+
+// Function to mark the simulation as finished, then detach and remove the statistics segment
+// Readers still attached keep their view of it until they detach
+void removeStats()
+{
+	if (stats == NULL)
+		return;
+	statsPublish();
+	stats->done.store(1);
+	if (shmdt(stats) == -1)
+	{
+		perror("shmdt failed");
+		exit(1);
+	}
+	if (shmctl(stats_id, IPC_RMID, NULL) == -1)
+	{
+		perror("shmctl failed");
+		exit(1);
+	}
+	stats = NULL;
+}
+
+// Function to read a comma-separated list of CPUs and CPU ranges, such as 0,2-5, into workerCpus
+// Returns 0 on success, -1 if the list is malformed or names a CPU oss is not allowed to run on
+int parseCpuList(const char* text)
+{
+	cpu_set_t allowed;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+		return -1;
+	workerCpus = new int[CPU_SETSIZE];
+	workerCpuCount = 0;
+	const char* item = text;
+	while (*item != '\0')
+	{
+		char* end;
+		long first = strtol(item, &end, 10);
+		long last = first;
+		if (end == item)
+			return -1;
+		if (*end == '-')
+		{
+			item = end + 1;
+			last = strtol(item, &end, 10);
+			if (end == item)
+				return -1;
+		}
+		if ((*end != ',' && *end != '\0') || first < 0 || last < first || last >= CPU_SETSIZE)
+			return -1;
+		for (long cpu = first; cpu <= last; cpu++)
+		{
+			if (!CPU_ISSET(cpu, &allowed) || workerCpuCount == CPU_SETSIZE)
+				return -1;
+			workerCpus[workerCpuCount++] = (int)cpu;
+		}
+		item = *end == ',' ? end + 1 : end;
+	}
+	return workerCpuCount > 0 ? 0 : -1;
+}
+
+// Function to start watching a new worker for its exit
+void watchWorker(pid_t pid, int slot)
 {
-	printf("3 seconds have passed, process(es) will now terminate.\n");
-	pid_t pid;
+	int pidfd = syscall(SYS_pidfd_open, pid, 0);
+	if (pidfd == -1)
+	{
+		perror("pidfd_open failed");
+		exit(1);
+	}
+	int w;
+	if (freeWatches.empty())
+	{
+		w = watches.size();
+		watches.push_back(workerWatch());
+	}
+	else
+	{
+		w = freeWatches.back();
+		freeWatches.pop_back();
+	}
+	watches[w].pidfd = pidfd;
+	watches[w].slot = slot;
+
+	// Keep the watch's index and PID in the event so reaping needs no lookup
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.u64 = ((uint64_t)w << 32) | (uint32_t)pid;
+	if (epoll_ctl(lifeEpoll, EPOLL_CTL_ADD, pidfd, &ev) == -1)
+	{
+		perror("epoll_ctl failed");
+		exit(1);
+	}
+}
 
-	// Loop through process table to find all processes still running and terminate
-	for (int i = 0; i < 18; i++)
+// Function to fork and exec a worker for table index slot. Returns its PID
+pid_t launchWorker(int slot)
+{
+	// Clear the slot's mailbox before the new worker can see it
+	if (useMailbox)
+		resetMailbox(slot);
+
+	// Worker is given the IDs of the clock and the queues, and of the mailboxes when they are used
+	char idStr[64];
+	snprintf(idStr, sizeof(idStr), "%d,%d,%d,%d", shm_id, msqid, rmsqid, mb_id);
+	// Worker is given its table index when using mailboxes so it knows which mailbox to use
+	char slotStr[16];
+	snprintf(slotStr, sizeof(slotStr), "%d", slot);
+	// Worker is given the workload mix, and the most CPU time a job may use
+	char mixStr[32];
+	snprintf(mixStr, sizeof(mixStr), "%d,%d", termPct, blockPct);
+	char runLimitStr[32];
+	snprintf(runLimitStr, sizeof(runLimitStr), "%lld", runLimitNs);
+	// Worker is given the load and how many units of it to do per simulated second
+	char loadStr[48];
+	snprintf(loadStr, sizeof(loadStr), "%d:%lld", loadKind, loadUnitsPerSec);
+
+	pid_t childPid = fork();
+	if (childPid == 0) // Child process
 	{
-		if(processTable[i].occupied)
+		// Join the workers' process group, or lead it if this is the first worker. The parent does the same so
+		// neither has to wait for the other
+		setpgid(0, workerPgid);
+
+		// Pin worker to its CPU before exec, the mask is kept across it
+		if (workerCpuCount > 0)
 		{
-			pid = processTable[i].pid;
-			if (pid > 0)
-				kill(pid, SIGKILL);
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(workerCpus[slot % workerCpuCount], &set);
+			if (sched_setaffinity(0, sizeof(set), &set) == -1)
+			{
+				perror("sched_setaffinity failed");
+				exit(1);
+			}
+		}
+
+		// Create array of arguments to pass to exec. "./worker" is the program to execute, followed by
+		// "-i ids" for the IPC objects, "-m slot" for mailbox transport, "-p" for a pooled worker, "-w T,B" for
+		// the workload mix, "-t ns" for the run time limit and "-l kind:units" for real work, and NULL shows it is
+		// the end of the argument list
+		char* args[15];
+		int argn = 0;
+		args[argn++] = (char*)"./worker";
+		args[argn++] = (char*)"-i";
+		args[argn++] = idStr;
+		args[argn++] = (char*)"-w";
+		args[argn++] = mixStr;
+		if (runLimitNs > 0)
+		{
+			args[argn++] = (char*)"-t";
+			args[argn++] = runLimitStr;
+		}
+		if (useMailbox)
+		{
+			args[argn++] = (char*)"-m";
+			args[argn++] = slotStr;
 		}
+		if (usePool)
+			args[argn++] = (char*)"-p";
+		if (loadKind != LOAD_NONE)
+		{
+			args[argn++] = (char*)"-l";
+			args[argn++] = loadStr;
+		}
+		args[argn] = NULL;
+		// Replace current process with "./worker" process
+		execvp(args[0], args);
+		// If this prints, means exec failed
+		// Prints error message and exits
+		fprintf(stderr, "Exec failed, terminating!\n");
+		exit(1);
+	}
+	if (childPid == -1)
+	{
+		perror("fork failed");
+		exit(1);
+	}
+	setpgid(childPid, workerPgid);
+	if (workerPgid == 0)
+		workerPgid = childPid;
+	watchWorker(childPid, slot);
+	return childPid;
+}
+
+// Function to wake oss if it is waiting for a reply. Only posts to a mailbox or sends a message, so signal handlers
+// can call it
+void wakeOss()
+{
+	// A signal can come before the mailboxes or reply queue are set up, and then there is nothing to wake
+	if (useMailbox)
+	{
+		if (mbHeader != NULL)
+			mbPost(&mbHeader->replySeq, &mbHeader->ossSleeping);
+	}
+	else
+	{
+		msgbuffer buf;
+		buf.mtype = WAKE_MTYPE;
+		buf.strData[0] = '\0';
+		buf.intData = 0;
+		msgsnd(rmsqid, &buf, sizeof(msgbuffer) - sizeof(long), IPC_NOWAIT);
 	}
+}
+
+// Function to run on SIGCHLD. Wakes oss if it is waiting for a reply, once until oss has reaped
+void childHandler(int sig)
+{
+	if (exitPending)
+		return;
+	exitPending = 1;
+	wakeOss();
+}
+
+// Function to reap every worker that has exited. A worker that exits while it still has a job is marked, so its
+// job is ended as soon as it is dispatched or, if it is already in flight, without waiting for a reply that
+// will never come
+void reapExited()
+{
+	exitPending = 0;
+	struct epoll_event events[64];
+	int n;
+	do
+	{
+		n = epoll_wait(lifeEpoll, events, 64, 0);
+		for (int e = 0; e < n; e++)
+		{
+			int w = (int)(events[e].data.u64 >> 32);
+			pid_t pid = (pid_t)(uint32_t)events[e].data.u64;
+			int i = watches[w].slot;
+			epoll_ctl(lifeEpoll, EPOLL_CTL_DEL, watches[w].pidfd, NULL);
+			close(watches[w].pidfd);
+			freeWatches.push_back(w);
+			// The group leader stays a zombie until teardown, so the group can still be joined
+			if (pid != workerPgid)
+				waitpid(pid, NULL, 0);
+
+			// Mark the job the worker was running, if its entry has not been given to another worker since
+			// A free entry still holding the pid is harmless, spawning resets exited
+			if (processTable.pid[i] == pid)
+				processTable.exited[i] = 1;
+			// A pooled worker with no job is replaced right away, one with a job once the job has ended
+			if (usePool && poolPids[i] == pid && !processTable.occupied[i])
+				poolPids[i] = launchWorker(i);
+		}
+	} while (n == 64);
+}
+
+// Function to reap every worker, waiting for any that have not exited yet
+void reapAll()
+{
+	while (waitpid(-1, NULL, 0) > 0 || errno == EINTR)
+		;
+}
+
+// Function to kill every worker in one call and reap them all
+void killWorkers()
+{
+	if (workerPgid > 0)
+		kill(-workerPgid, SIGKILL);
+	reapAll();
+}
+
+// Function to terminate everything once SIGALRM, SIGINT or SIGTERM has asked to. The handler only sets stopSignal,
+// and oss calls this wherever it loops or waits, so the teardown below never runs inside a signal handler
+void stopIfSignaled()
+{
+	if (stopSignal == 0)
+		return;
+	if (stopSignal == SIGALRM)
+		printf("%d seconds have passed, process(es) will now terminate.\n", realTimeLimit);
+	else
+		printf("Interrupted, process(es) will now terminate.\n");
+
+	// Kill every worker, including pooled ones with no job, with one signal to their process group
+	killWorkers();
+	// Publish final statistics if -S was given and remove them, while the clock is still attached
+	removeStats();
+
 	 // Detach from shared memory and remove it
-        if(shmdt(shm_ptr) == -1)
+        if(shmdt(sysClock) == -1)
         {
                 perror("shmdt failed");
                 exit(1);
@@ -236,419 +817,1879 @@ void signal_handler(int sig)
                 exit(1);
         }
 
-        // Remove the message queue
-        if (msgctl(msqid, IPC_RMID, NULL) == -1)
-        {
-                perror("msgctl failed");
+        // Remove the message queues
+        if (removeQueues() == -1)
                 exit(1);
-        }
 
+	// Remove mailboxes if mailbox transport was used
+	removeMailboxes();
+
+	// Write out whatever is still waiting in the log buffer and trace
+	logClose();
+	traceClose();
 
 	exit(1);
 }
 
-int main(int argc, char* argv[])
+// Signal handler for SIGALRM after realTimeLimit seconds in real time, SIGINT and SIGTERM. Asks oss to terminate
+// everything and wakes it if it is waiting for a reply
+void signal_handler(int sig)
 {
-	// Signal that will terminate program after 3 sec (real time)
-	signal(SIGALRM, signal_handler);
-	alarm(3);
+	stopSignal = sig;
+	wakeOss();
+}
 
-	msgbuffer buf; // Buffer for sending messages to child processes
-	msgbuffer rcvbuf; // Buffer for receiving messages from child processes
-	key_t key; // Key to access queue
+// Function to send a message to a worker. SysV message calls are not restarted after a signal such as SIGCHLD,
+// so the send is retried. Returns 0 if it was sent, -1 otherwise
+int sendMessage(msgbuffer* buf)
+{
+	int rc;
+	while ((rc = msgsnd(msqid, buf, sizeof(msgbuffer) - sizeof(long), 0)) == -1 && errno == EINTR)
+		;
+	return rc;
+}
 
-	// Create file to track message queue
-	system("touch msgq.txt");
+// Function to hand a new job to the pooled worker of table index indx, with a fresh random seed
+void startJob(int indx, unsigned int seed)
+{
+	if (useMailbox)
+	{
+		// Published to the worker by the job's first dispatch
+		mailboxes[indx].seed = seed;
+		mailboxes[indx].newJob = 1;
+		return;
+	}
 
-	// Get key for message queue
-	if ((key = ftok("msgq.txt", 1)) == -1)
+	msgbuffer buf;
+	buf.mtype = poolPids[indx];
+	buf.intData = (int)seed;
+	strcpy(buf.strData, "job");
+	if (sendMessage(&buf) == -1)
 	{
-		perror("ftok");
+		perror("msgsnd failed");
 		exit(1);
 	}
+}
+
+// Function to start one pooled worker for every table entry
+void startPool()
+{
+	poolPids = new pid_t[tableSize];
+	for (int i = 0; i < tableSize; i++)
+		poolPids[i] = launchWorker(i);
+}
 
-	// Create message queue
-	if ((msqid = msgget(key, PERMS | IPC_CREAT)) == -1)
+// Function to start job number job in table index slot: hand it to the pooled worker, start it in oss, or fork a
+// worker for it. Returns the PID running it, 0 for a job run in oss
+pid_t launchJob(int slot, int job)
+{
+	unsigned int seed = jobSeedBase * 2654435761u + job;
+	if (inProcess)
 	{
-		perror("msgget in parent\n");
-		exit(1);
-	}	
+		jobStart(&inJobs[slot], seed);
+		return 0;
+	}
+	if (usePool)
+	{
+		startJob(slot, seed);
+		return poolPids[slot];
+	}
+	return launchWorker(slot);
+}
 
-	printf("Message queue set up\n");
+// Function to tell every pooled worker to exit. They are reaped with every other worker
+void stopPool()
+{
+	for (int i = 0; i < tableSize; i++)
+	{
+		if (useMailbox)
+		{
+			mailboxes[i].quantum = -1;
+			mbPost(&mailboxes[i].dispatchSeq, &mailboxes[i].workerSleeping);
+		}
+		else
+		{
+			msgbuffer buf;
+			buf.mtype = poolPids[i];
+			buf.intData = -1;
+			strcpy(buf.strData, "stop");
+			sendMessage(&buf);
+		}
+	}
+}
 
-	logfile = fopen("ossLog.txt", "w");
-	if(logfile == NULL)
+// Function to hand the main loop the next quantum of table index indx's last grant
+// Every quantum but the last was used in full. The last is scaled if the process has since been given a different quantum
+void takeBatched(int indx, int* status, int* used)
+{
+	int quantum = processTable.dispatchQuantum[indx];
+	if (--batchLeft[indx] > 0)
 	{
-		fprintf(stderr, "Failed to open log file.\n");
-		return EXIT_FAILURE;
+		*status = 1;
+		*used = quantum;
+		return;
 	}
+	*status = batchStatus[indx];
+	*used = batchUsed[indx];
+	if (batchQuantum[indx] != quantum && batchQuantum[indx] > 0)
+		*used = *status == 1 ? quantum : (int)((long long)*used * quantum / batchQuantum[indx]);
+}
 
-	// Values to keep track of child iterations
-	int total = 0; // Total amount of processes
-	int running = 0;
-	//int lastForkSec = 0; // Time in sec since last fork
-	//int lastForkNs = 0; // Time in ns since last fork
-	int msgsnt = 0;
+// Function to keep a worker's reply to a grant. runs is how many quanta it ran, status and used describe the last
+void keepBatched(int indx, int runs, int status, int used)
+{
+	batchLeft[indx] = runs > 0 ? runs : 1;
+	batchStatus[indx] = status;
+	batchUsed[indx] = used;
+	batchQuantum[indx] = processTable.dispatchQuantum[indx];
+}
 
-	const char optstr[] = "hn:s:t:i:f"; // Options h, n, s, t, i, f
-	char opt;
-	
-	// Set up shared memory for clock
-	shareMem();
+// Function to get the name of the dispatch transport, for reports
+const char* transportName()
+{
+	return inProcess ? "in-process" : useMailbox ? "mailbox" : "msgq";
+}
 
-	// Allocate memory for process table based on total processes
-	processTable = new PCB[20];
+// Function to get the name of the job launch mode, for reports
+const char* launchName()
+{
+	return inProcess ? "in-process" : usePool ? "pool" : "fork";
+}
 
-	// Variables to track last printed time
-	long long int lastPrintSec = shm_ptr[0];
-	long long int lastPrintNs = shm_ptr[1];
+// Function to send a time quantum to the worker in table index indx, letting it run up to grant quanta before replying
+// When replaying a trace, scripted is set and the worker replies with scriptStatus and scriptUsed instead of drawing them
+// Returns SEND_OK, SEND_GONE if the worker has exited, or SEND_FAILED
+int sendQuantum(int indx, int quantum, int grant, int scripted, int scriptStatus, int scriptUsed)
+{
+	// Worker already ran this quantum as part of its last grant, its outcome is waiting in batchLeft
+	if (batchLeft[indx] > 0)
+		return SEND_OK;
+	// Job runs in oss, so draw how its quanta turn out now and keep the outcome as if a worker had replied at once
+	if (inProcess)
+	{
+		int runs = 0;
+		int status;
+		int used = scriptUsed;
+		do
+		{
+			status = scripted ? scriptStatus : jobQuantum(&inJobs[indx], &inMix, quantum, &used);
+			runs++;
+		} while (status == 1 && runs < grant);
+		keepBatched(indx, runs, status, used);
+		return SEND_OK;
+	}
+	// Worker has exited and will never run it. A mailbox still counts the dispatch, so its last reply is not
+	// mistaken for an answer to this one
+	if (processTable.exited[indx])
+	{
+		if (useMailbox)
+			mailboxes[indx].dispatchSeq.fetch_add(1);
+		return SEND_GONE;
+	}
+	grantsSent++;
 
-	// Initialize process table, all values set to 0
-	for (int i = 0; i < 18; i++)
-	{
-		processTable[i].occupied = 0;
-		processTable[i].serviceTimeSeconds = 0;
-		processTable[i].serviceTimeNano = 0;
-		processTable[i].eventWaitSec = 0;
-		processTable[i].eventWaitNano = 0;
-		processTable[i].blocked = 0;
-	}
-
-	// Max number of sec allowed between spawning processes
-	const int maxBetProcSec = 1;
-	// Max number of ns allowed between spawning processes
-	const int maxBetProcNs = 1000;
-	// Variable to hold current time in ns. Calculate using memory pointers representng system time.
-	long long currTimeNs = ((long long)shm_ptr[0] * 1000000000) + shm_ptr[1];
-	// Generate random number of sec and ns between 0 through max allowed
-	int randSec = rand() % (maxBetProcSec + 1);
-	int randNs = rand() % (maxBetProcNs + 1);
-	// Calculate total random delay in ns
-	long long randDelay = ((long long)randSec * 1000000000) + randNs;
-	// Calculate next spawn time in ns by adding random delay to current time
-	long long nSpawnT = currTimeNs + randDelay;
-
-	// Loop that will continue until amount of 100 total child processes is reached or until running processes is 0
-	// Ensures only 100 total  processes are able to run, and that no processses are still running when the loop ends
-	while (total < 100 ||  running > 0)
+	if (useMailbox)
 	{
-		// Update system clock
-		incrementClock();
-		long long currTimeNs = ((long long)shm_ptr[0] * 1000000000) + shm_ptr[1];
+		// Post quantum in the slot's mailbox and wake worker if it is sleeping
+		mailboxes[indx].quantum = quantum;
+		mailboxes[indx].grant = grant;
+		mailboxes[indx].scripted = scripted;
+		mailboxes[indx].scriptStatus = scriptStatus;
+		mailboxes[indx].scriptUsed = scriptUsed;
+		mbPost(&mailboxes[indx].dispatchSeq, &mailboxes[indx].workerSleeping);
+		return SEND_OK;
+	}
 
-		// Calculate time since last print for sec and ns
-		long long int printDiffSec = shm_ptr[0] - lastPrintSec;
-		long long int printDiffNs = shm_ptr[1] - lastPrintNs;
-		// Adjust ns value for subtraction resulting in negative value
-		if (printDiffNs < 0)
-		{
-			printDiffSec--;
-			printDiffNs += 1000000000;
-		}
-		// Calculate total time sincd last print in ns
-		long long int printTotDiff = printDiffSec * 1000000000 + printDiffNs;
+	// Prepare info for message to child
+	msgbuffer buf;
+	buf.mtype = processTable.pid[indx];
+	buf.intData = quantum;
+	if (scripted)
+		snprintf(buf.strData, sizeof(buf.strData), "replay %d %d", scriptStatus, scriptUsed);
+	else if (grant > 1)
+		snprintf(buf.strData, sizeof(buf.strData), "grant %d", grant);
+	else
+		strcpy(buf.strData, "1");
+
+	// Send message to child process
+	return sendMessage(&buf);
+}
 
-		if (printTotDiff >= 500000000) // Determine if time of last print surpasssed .5 sec system time
-		{
-			// If true, print table and MLFQ info and update time since last print in sec and ns
-			printInfo(18);
-			lastPrintSec = shm_ptr[0];
-			lastPrintNs = shm_ptr[1];
-		}
+// Function to keep a worker's reply message and hand the main loop its first quantum
+void takeMessage(int indx, const msgbuffer* buf, int* status, int* used)
+{
+	// Worker sends "0", "1" or "-1" as string data, followed by how many quanta it ran if it was given a grant
+	int runs = 1;
+	sscanf(buf->strData, "%*d %d", &runs);
+	keepBatched(indx, runs, atoi(buf->strData), buf->intData);
+	takeBatched(indx, status, used);
+}
+
+// Function to wait for the first reply from any in-flight worker and remove it from the in-flight list
+// Returns its table index. Sets status to 0 (terminated), 1 (used full quantum) or -1 (blocked) and used to the ns of quantum used
+int receiveAnyReply(int* status, int* used)
+{
+	msgbuffer rcvbuf;
+	while (true)
+	{
+		// Terminate if a signal asked to while oss was waiting
+		stopIfSignaled();
+		// Reap workers that have exited since oss last looked
+		if (exitPending)
+			reapExited();
 
-		// Temp queue to store processes still blocked
-		queue<int> tempBlocked;
-		// Iterate through blocked queue
-		while(!blockedQueue.empty())
+		for (int i = 0; i < inFlightCount; i++)
 		{
-			// Take first process index from front of blocked queue and remove from queue
-			int bIndx = blockedQueue.front();
-			blockedQueue.pop();
+			int indx = inFlight[i];
+			// Quanta already run as part of a grant are answered without waiting
+			if (batchLeft[indx] > 0)
+			{
+				takeBatched(indx, status, used);
+				inFlight[i] = inFlight[--inFlightCount];
+				return indx;
+			}
+			if (!processTable.exited[indx])
+				continue;
 
-			// Determine what time process will finish being blocked in ns
-			long long waitEndNs = ((long long)processTable[bIndx].eventWaitSec * 1000000000) + processTable[bIndx].eventWaitNano;
-			if (currTimeNs >= waitEndNs) // Process passed blocked time
+			// Worker has exited, but may have replied first
+			if (useMailbox && mailboxes[indx].replySeq.load(std::memory_order_acquire) == mailboxes[indx].dispatchSeq.load(std::memory_order_relaxed))
+				continue;
+			if (!useMailbox && msgrcv(rmsqid, &rcvbuf, sizeof(msgbuffer) - sizeof(long), processTable.pid[indx], IPC_NOWAIT) != -1)
 			{
-				// Push blocked process to top priority queue
-				rQueue0.push(bIndx);
-
-				// Increment total time blocked by amount of time process waited while blocked
-				totalBlockedTimeNs += ((long long)processTable[bIndx].eventWaitSec * 1000000000) + processTable[bIndx].eventWaitNano;
-				
-				// Reset process's values in PCB to reflect no longer being blocked
-				processTable[bIndx].eventWaitSec = 0;
-				processTable[bIndx].eventWaitNano = 0;
-				processTable[bIndx].blocked = 0;
-
-				// Add additional overhead for blocked scheduling
-				addOverhead();
-				addOverhead();
+				takeMessage(indx, &rcvbuf, status, used);
+				inFlight[i] = inFlight[--inFlightCount];
+				return indx;
 			}
-			else // Process has not passed blocked time
-				// Add process back to temp block queue
-				tempBlocked.push(bIndx);
-				
-		}
-		// Set blocked queue equal to temp blocked queue, adding back in all blocked process in original order
-		blockedQueue = tempBlocked;
 
-		// Update variable holding clock time in ns to system's current time in ns
-		currTimeNs = ((long long)shm_ptr[0] * 1000000000) + shm_ptr[1];
+			// It never will, so its job ends with nothing used. A pooled worker is replaced
+			crashedWorkers++;
+			logPrintf("Worker (index %d PID %d) exited without replying\n", indx, processTable.pid[indx]);
+			if (usePool)
+				poolPids[indx] = launchWorker(indx);
+			*status = 0;
+			*used = 0;
+			inFlight[i] = inFlight[--inFlightCount];
+			return indx;
+		}
 
-		// Determine if a new child process can be spawned
-		// Must be greater than next spawn time, less than total process allowed (100), and less than simultanous processes allowed (18)
-		if (currTimeNs >= nSpawnT && total < 100  && running < 18)
+		if (useMailbox)
 		{
-			//Fork new child
-			pid_t childPid = fork();
-			if (childPid == 0) // Child process
+			// Read header sequence before scanning so a reply posted during the scan still wakes oss
+			uint32_t last = mbHeader->replySeq.load();
+			for (int i = 0; i < inFlightCount; i++)
 			{
-				// Create array of arguments to pass to exec. "./worker" is the program to execute, arg is the command line argument
-				// to be passed to "./worker", and NULL shows it is the end of the argument list
-				char* args[] = {"./worker",  NULL};
-				// Replace current process with "./worker" process and pass iteration amount as parameter
-				execvp(args[0], args);
-				// If this prints, means exec failed
-				// Prints error message and exits
-				fprintf(stderr, "Exec failed, terminating!\n");
-				exit(1);
-			}
-			else // Parent process
-			{
-				// Increment total created processes and running processes
-				total++;
-				running++;
-					
-				// Increment clock
-				incrementClock();
-
-				// Update table with new child info
-				for (int i = 0; i < 18; i++)
+				int indx = inFlight[i];
+				// Each dispatch gets exactly one reply, so sequences match once the worker has answered
+				if (mailboxes[indx].replySeq.load(std::memory_order_acquire) == mailboxes[indx].dispatchSeq.load(std::memory_order_relaxed))
 				{
-					if (processTable[i].occupied == 0)
-					{
-						processTable[i].occupied = 1;
-						processTable[i].pid = childPid;
-						processTable[i].startSeconds = shm_ptr[0];
-						processTable[i].startNano = shm_ptr[1];
-						processTable[i].serviceTimeSeconds = 0;
-						processTable[i].serviceTimeNano = 0;
-						processTable[i].eventWaitSec = 0;
-						processTable[i].eventWaitNano = 0;
-						processTable[i].blocked = 0;
-						// Add process index to queue 0 since this process is ready to be scheduled
-						rQueue0.push(i);
-						// Increment insertions to queue 0
-						q0Count++;
-						break;
-					}
+					keepBatched(indx, mailboxes[indx].runs, mailboxes[indx].status, mailboxes[indx].used);
+					takeBatched(indx, status, used);
+					inFlight[i] = inFlight[--inFlightCount];
+					return indx;
 				}
-
-				// Calculate next randomly generated spawn time in ns
-				randSec = rand() % (maxBetProcSec);
-				randNs = rand() % (maxBetProcNs);
-				randDelay = (randSec * 1000000000) + randNs;
-				currTimeNs = (shm_ptr[0] * 1000000000) + shm_ptr[1];
-				nSpawnT = currTimeNs + randDelay;
-
 			}
+			// No in-flight worker has answered yet, sleep until one does or a worker exits
+			mbWait(&mbHeader->replySeq, &mbHeader->ossSleeping, last, mbSpin);
+			continue;
 		}
 
-
-		// Pointer to an integer queue to track the current ready queue being used
-		std::queue<int>* currQueue = nullptr;
-		// Find the first nonempty queue and set currQueue to point to it
-		if (!rQueue0.empty())
-			currQueue = &rQueue0;
-		else if (!rQueue1.empty())
-			currQueue = &rQueue1;
-		else if (!rQueue2.empty())
-			currQueue = &rQueue2;
-
-		if (currQueue != nullptr && !currQueue->empty())
+		// Wait for reply of any type, the type is the PID of the worker that sent it. A worker exiting interrupts the
+		// wait, and the loop goes to reap it
+		if (msgrcv(rmsqid, &rcvbuf, sizeof(msgbuffer) - sizeof(long), 0, 0) == -1)
 		{
-			// Retreive index of process that is at the front of the current queue
-			int indx = currQueue->front();
-			// Remove this process index from the current queue since it is being processed
-			currQueue->pop();
-
-			// Find pid of corresponding index in process table and set to childP
-			pid_t childP = processTable[indx].pid;
+			if (errno == EINTR)
+				continue;
+			perror("msgrcv failed");
+			exit(1);
+		}
+		// A worker exited, go reap it
+		if (rcvbuf.mtype == WAKE_MTYPE)
+			continue;
 
-			// Find time quantum for child process based on the queue it was in. 
-			// Process will be given this amount of time to run
-			int quantum = q0;
-			const char* qLevStr = "0";
-			if (currQueue == &rQueue1)
-			{
-				quantum = q1;
-				qLevStr = "1";
-			}
-			else if (currQueue == &rQueue2)
+		// Match reply to the in-flight worker that sent it
+		for (int i = 0; i < inFlightCount; i++)
+		{
+			int indx = inFlight[i];
+			if (processTable.pid[indx] == (pid_t)rcvbuf.mtype)
 			{
-				quantum = q2;
-				qLevStr = "2";
+				takeMessage(indx, &rcvbuf, status, used);
+				inFlight[i] = inFlight[--inFlightCount];
+				return indx;
 			}
+		}
+		fprintf(stderr, "Reply from PID %ld does not match any dispatched worker\n", rcvbuf.mtype);
+		exit(1);
+	}
+}
 
-			// Call function to add scheduling overhead to OS 
-			addOverhead();
-
-			// Prepare info for message to child
-			buf.mtype = childP;
-			buf.intData = quantum;
-			strcpy(buf.strData, "1");
+// Function to get the delay before job is spawned, drawn at random or taken from the trace being replayed, and
+// never less than the -i gap
+long long nextSpawnDelay(int job, int maxSec, int maxNs)
+{
+	long long delay;
+	if (traceReplaying())
+	{
+		// Trace ran out of spawns, spawn right away
+		delay = traceNextSpawn();
+		if (delay < 0)
+			delay = 0;
+	}
+	else
+	{
+		// Generate random number of sec and ns between 0 and the max allowed
+		int randSec = rand() % maxSec;
+		int randNs = rand() % maxNs;
+		delay = ((long long)randSec * 1000000000) + randNs;
+	}
+	traceAdd(TRACE_SPAWN, job, 0, (int)delay, 0);
+	return max(delay, minSpawnGapNs);
+}
 
-			// Send message to child process
-			if (msgsnd(msqid, &buf, sizeof(msgbuffer) - sizeof(long), 0) != -1)
-			{
-				msgsnt++; // Increment amount of messages sent
-				fprintf(logfile, "Dispatching process (index %d, queue level %s) with PID %d, time quantum %d at time %d:%d\n",
-						indx, qLevStr, childP, quantum, shm_ptr[0], shm_ptr[1]);
-			}
+// Function to note that entry i's line in the process table section has to be patched in or out at next print
+void markSlotChanged(int i)
+{
+	if (slotChanged[i])
+		return;
+	slotChanged[i] = 1;
+	changedSlots[changedCount++] = i;
+}
 
-			// Wait for child's reply
-			if (msgrcv(msqid, &rcvbuf, sizeof(msgbuffer) -sizeof(long), childP, 0) == -1)
-			{
-				perror("msgrcv failed");
-				exit(1);
-			}			
+// Function to cache the status print text of a newly spawned process, so printInfo only copies it
+void cacheSlotText(int i)
+{
+	slotTexts[i].lineLen = snprintf(slotTexts[i].line, sizeof(slotTexts[i].line), "%d\t%d\t\t%d\t%u\t%u\n",
+			i, processTable.occupied[i], processTable.pid[i], clockSec(processTable.startNs[i]), clockNano(processTable.startNs[i]));
+	slotTexts[i].tokenLen = snprintf(slotTexts[i].token, sizeof(slotTexts[i].token), "[Table Index: %d; PID: %d] ", i, processTable.pid[i]);
+	markSlotChanged(i);
+}
 
-			childP = rcvbuf.mtype;
+// Function to add a simulated time to a metric's histogram for all queues and the one for queue level
+void recordMetric(int metric, int level, long long ns)
+{
+	latencyHist* row = &metricHists[metric * (readyLevels + 1)];
+	histRecord(&row[0], ns);
+	histRecord(&row[level + 1], ns);
+}
 
-			// Update variable holding clock time in ns to system's current time in ns
-			currTimeNs = ((long long)shm_ptr[0] * 1000000000) + shm_ptr[1];
-			
-			fprintf(logfile, "Receiving message from worker (index %d PID %d) at time %d:%d\n",
-					indx, rcvbuf.intData, shm_ptr[0], shm_ptr[1]);
-
-			// Retrieve message from worker containing amount of simulated time they used in ns
-			int quanUsed = rcvbuf.intData;
-			// Increment system clock by that time in ns
-			shm_ptr[1] += quanUsed;
-			if (shm_ptr[1] >= 1000000000) 
-			{
-				// If ns overflowed into seconds, adjust system time for this
-				shm_ptr[0] += shm_ptr[1] / 1000000000;
-				shm_ptr[1] %= 1000000000;
-			}
+// Function to get the most text formatLatency can produce
+int latencyTextMax()
+{
+	return 160 + METRICS * (readyLevels + 1) * 96;
+}
 
-			// Split quantum into whole seconds and leftover ns
-			long long usedSec = quanUsed / 1000000000;
-			long long usedNs = quanUsed % 1000000000;
+// Function to format p50/p90/p99/max of every metric into buf, one line for all queues and one for each queue
+// that has values. Returns the length of the text
+int formatLatency(char* buf, int cap)
+{
+	int len = snprintf(buf, cap, "----Latency Percentiles (simulated ns)----\n%-10s %5s %10s %14s %14s %14s %14s\n",
+			"Metric", "Queue", "Count", "p50", "p90", "p99", "max");
+	for (int m = 0; m < METRICS; m++)
+	{
+		for (int l = 0; l <= readyLevels; l++)
+		{
+			const latencyHist* h = &metricHists[m * (readyLevels + 1) + l];
+			if (l > 0 && h->total == 0)
+				continue;
+			char queue[8];
+			if (l == 0)
+				strcpy(queue, "all");
+			else
+				snprintf(queue, sizeof(queue), "%d", l - 1);
+			len += snprintf(buf + len, cap - len, "%-10s %5s %10lld %14lld %14lld %14lld %14lld\n", metricNames[m], queue,
+					h->total, histPercentile(h, 50), histPercentile(h, 90), histPercentile(h, 99), h->max);
+		}
+	}
+	return len;
+}
 
-			// Add used seconds and ns to process's service time in PCB
-			processTable[indx].serviceTimeSeconds += usedSec;
-			processTable[indx].serviceTimeNano += usedNs;
-			if (processTable[indx].serviceTimeNano >= 1000000000)
-			{
-				// If ns overflowed into seconds, adjust PCB values for this
-				processTable[indx].serviceTimeSeconds += processTable[indx].serviceTimeNano / 1000000000;
-				processTable[indx].serviceTimeNano %=  1000000000;
+// Function to format each queue's tuned quantum and the time its runs used into buf. Returns the length of the text
+int formatTuner(char* buf, int cap)
+{
+	int len = snprintf(buf, cap, "----Adaptive Quanta (target %d%% of runs within quantum)----\n%-5s %12s %12s %10s %7s %14s %14s %7s\n",
+			tuner.targetPct, "Queue", "Quantum", "Configured", "Runs", "Within", "Used p50", "Used p90", "Retunes");
+	for (int l = 0; l < tuner.numLevels; l++)
+	{
+		const latencyHist* h = &tuner.usage[l];
+		len += snprintf(buf + len, cap - len, "%-5d %12d %12d %10lld %6lld%% %14lld %14lld %7d\n", l, tuner.quanta[l], tuner.baseQuanta[l],
+				h->total, h->total > 0 ? tuner.within[l] * 100 / h->total : 0, histPercentile(h, 50), histPercentile(h, 90), tuner.retunes[l]);
+	}
+	return len;
+}
+
+// Function to get where entry i's line starts in tableText, the length of every line before it
+int tableLineStart(int i)
+{
+	int start = 0;
+	for (int j = i; j > 0; j -= j & -j)
+		start += tableLenTree[j];
+	return start;
+}
+
+// Function to patch the process table section for the entries that changed since the last print. Lines between
+// them are copied across in one piece each, and only the changed entries' lines are added or left out
+void patchTableText()
+{
+	if (changedCount == 0)
+		return;
+	sort(changedSlots, changedSlots + changedCount);
+
+	int src = 0;
+	int dst = 0;
+	for (int k = 0; k < changedCount; k++)
+	{
+		int i = changedSlots[k];
+		int start = tableLineStart(i);
+		memcpy(tableSpare + dst, tableText + src, start - src);
+		dst += start - src;
+		src = start + tableLineLen[i];
+		if (processTable.occupied[i])
+		{
+			memcpy(tableSpare + dst, slotTexts[i].line, slotTexts[i].lineLen);
+			dst += slotTexts[i].lineLen;
+		}
+	}
+	memcpy(tableSpare + dst, tableText + src, tableTextLen - src);
+	dst += tableTextLen - src;
+
+	// Every start above was found from the old lengths, so they are only updated now
+	for (int k = 0; k < changedCount; k++)
+	{
+		int i = changedSlots[k];
+		int lineLen = processTable.occupied[i] ? slotTexts[i].lineLen : 0;
+		for (int j = i + 1; j <= tableSize; j += j & -j)
+			tableLenTree[j] += lineLen - tableLineLen[i];
+		tableLineLen[i] = lineLen;
+		slotChanged[i] = 0;
+	}
+	changedCount = 0;
+	swap(tableText, tableSpare);
+	tableTextLen = dst;
+}
+
+// Function to append len bytes of text to the status print buffer
+void snapAppend(const char* text, int len)
+{
+	memcpy(snapBuf + snapLen, text, len);
+	snapLen += len;
+}
+
+// Append a string literal to the status print buffer without measuring it at run time
+#define snapAppendText(text) snapAppend(text, sizeof(text) - 1)
+
+// FUnction to print formatted process table and contents of the policy's ready queues
+// The report is built once in snapBuf from cached per-process text, then written to the console and log file
+// With -M, each CPU's queues are shown in turn
+template <typename Policy>
+void printInfo(const Policy* policies, int count)
+{
+	long long nowNs = clockNow(sysClock);
+	snapLen = 0;
+
+	// Header
+	snapLen += snprintf(snapBuf, snapCap, "OSS PID: %d SysClockS: %u SysClockNano: %u\n Process Table:\n", getpid(), clockSec(nowNs), clockNano(nowNs));
+	snapAppendText("Entry\tOccupied\tPID\tStartS\tStartNs\n");
+
+	// Process table section only changes when a process is spawned or terminates, patch in those entries' lines
+	patchTableText();
+	snapAppend(tableText, tableTextLen);
+	snapAppendText("\n");
+	int tableEnd = snapLen;
+
+	// Walk each ready queue in place, copying the cached text of every process in it
+	for (int c = 0; c < count; c++)
+	{
+		for (int q = 0; q < policies[c].levels(); q++)
+		{
+			if (count > 1)
+				snapLen += snprintf(snapBuf + snapLen, snapCap - snapLen, "CPU %d Queue %d: ", c, q);
+			else
+				snapLen += snprintf(snapBuf + snapLen, snapCap - snapLen, "Queue %d: ", q);
+			policies[c].visit(q, [](int indx) { snapAppend(slotTexts[indx].token, slotTexts[indx].tokenLen); });
+			snapAppendText("\n");
+		}
+	}
+	snapAppendText("------------------\n");
+	// Distributions so far, if -H was given
+	if (histAtPrint)
+		snapLen += formatLatency(snapBuf + snapLen, snapCap - snapLen);
+	snapAppendText("\n\n");
+
+	// Write the report once to each place. The console and log file have always used different MLFQ headers
+	fwrite(snapBuf, 1, tableEnd, stdout);
+	fputs("----MLFQ State----\n", stdout);
+	fwrite(snapBuf + tableEnd, 1, snapLen - tableEnd, stdout);
+	logWrite(snapBuf, tableEnd);
+	logWrite("-----MLFQ State----\n", sizeof("-----MLFQ State----\n") - 1);
+	logWrite(snapBuf + tableEnd, snapLen - tableEnd);
+}
+
+// Function to walk the options a checkpoint was taken with. A restart runs with them too, so it carries on the
+// same simulation whatever was given on its command line
+void transferConfig(stateIO* io)
+{
+	stateArray(io, &tableSize, 1);
+	stateArray(io, &maxTotal, 1);
+	stateArray(io, &cpus, 1);
+	stateArray(io, &policyKind, 1);
+	stateArray(io, &policyParam, 1);
+	stateArray(io, &numLevels, 1);
+	stateArray(io, levelQuanta, MAX_LEVELS);
+	stateArray(io, &termPct, 1);
+	stateArray(io, &blockPct, 1);
+	stateArray(io, &runLimitNs, 1);
+	stateArray(io, &minSpawnGapNs, 1);
+	stateArray(io, &eventMode, 1);
+	stateArray(io, &adaptPct, 1);
+	stateArray(io, &inProcess, 1);
+	stateArray(io, &jobSeedBase, 1);
+}
+
+// Function to walk the process table, one field at a time
+void transferTable(stateIO* io)
+{
+	stateArray(io, processTable.occupied, tableSize);
+	stateArray(io, processTable.pid, tableSize);
+	stateArray(io, processTable.startNs, tableSize);
+	stateArray(io, processTable.messagesSent, tableSize);
+	stateArray(io, processTable.serviceNs, tableSize);
+	stateArray(io, processTable.eventWaitNs, tableSize);
+	stateArray(io, processTable.blockStartNs, tableSize);
+	stateArray(io, processTable.blocked, tableSize);
+	stateArray(io, processTable.launchRealNs, tableSize);
+	stateArray(io, processTable.level, tableSize);
+	stateArray(io, processTable.dispatchRealNs, tableSize);
+	stateArray(io, processTable.job, tableSize);
+	stateArray(io, processTable.dispatchQuantum, tableSize);
+	stateArray(io, processTable.readyNs, tableSize);
+	stateArray(io, processTable.blockedNs, tableSize);
+	stateArray(io, processTable.exited, tableSize);
+	stateArray(io, processTable.cpu, tableSize);
+}
+
+// Function to walk the jobs run in oss with -I: each one's random generator and the CPU time it has used
+// The generator keeps its place as pointers into its own state, so those are walked as offsets into the state and
+// pointed back into it once loaded
+void transferJobs(stateIO* io)
+{
+	for (int i = 0; i < tableSize; i++)
+	{
+		jobState* job = &inJobs[i];
+		long long place[2] = {0, 0};
+		if (!io->loading && job->rng.state != NULL)
+		{
+			place[0] = job->rng.fptr - job->rng.state;
+			place[1] = job->rng.rptr - job->rng.state;
+		}
+		stateArray(io, job->rngState, sizeof(job->rngState) / sizeof(job->rngState[0]));
+		stateArray(io, place, 2);
+		stateArray(io, &job->usedNs, 1);
+		if (io->buf == NULL || !io->loading || !processTable.occupied[i])
+			continue;
+
+		// Starting the job sets up the generator's other fields, then the loaded state replaces the new one
+		int32_t loaded[sizeof(job->rngState) / sizeof(job->rngState[0])];
+		long long usedNs = job->usedNs;
+		memcpy(loaded, job->rngState, sizeof(loaded));
+		jobStart(job, 1);
+		memcpy(job->rngState, loaded, sizeof(loaded));
+		job->rng.fptr = job->rng.state + place[0];
+		job->rng.rptr = job->rng.state + place[1];
+		job->usedNs = usedNs;
+	}
+}
+
+// Function to walk everything a checkpoint holds: the options, clock, spawn schedule, process table, blocked
+// queue, the policy's ready queues, every statistic and oss's random generator
+// Only called between main loop iterations with no worker in flight, so no reply is ever part of the state
+template <typename Policy>
+void transferState(Policy& policy, stateIO* io, long long* lastPrintNs, long long* nSpawnT)
+{
+	transferConfig(io);
+
+	long long nowNs = clockNow(sysClock);
+	stateArray(io, &nowNs, 1);
+	if (io->buf != NULL && io->loading)
+		sysClock->ns.store(nowNs);
+	stateArray(io, lastPrintNs, 1);
+	stateArray(io, nSpawnT, 1);
+	stateArray(io, &total, 1);
+	stateArray(io, &running, 1);
+	stateArray(io, &msgsnt, 1);
+
+	transferTable(io);
+	if (inProcess)
+		transferJobs(io);
+	stateVector(io, &blockedQueue, tableSize);
+	stateArray(io, &blockedSeq, 1);
+	policy.transfer(io);
+	// Quanta each worker has already run from its last grant
+	stateArray(io, batchLeft, tableSize);
+	stateArray(io, batchStatus, tableSize);
+	stateArray(io, batchUsed, tableSize);
+	stateArray(io, batchQuantum, tableSize);
+
+	stateArray(io, queueCount, MAX_LEVELS);
+	stateArray(io, &blockedCount, 1);
+	stateArray(io, &totalTurnaroundTimeNs, 1);
+	stateArray(io, &terminatedProcesses, 1);
+	stateArray(io, &totalIdleTimeNs, 1);
+	stateArray(io, &totalServiceTimeNs, 1);
+	stateArray(io, &totalBlockedTimeNs, 1);
+	stateArray(io, metricHists, METRICS * (readyLevels + 1));
+	stateArray(io, &dispatchHist, 1);
+	stateArray(io, &launchHist, 1);
+	stateArray(io, &tickHist, 1);
+	stateArray(io, &dispatchWallNs, 1);
+	stateArray(io, &dispatchCount, 1);
+	stateArray(io, &totalLaunchNs, 1);
+	stateArray(io, &launchedJobs, 1);
+	stateArray(io, &grantsSent, 1);
+	stateArray(io, &grantQuanta, 1);
+	stateArray(io, &crashedWorkers, 1);
+
+	// Switching to the state rand() already uses stores its position in it, so it is complete when copied
+	// Before loading, rand() is moved off it, since switching away stores the old position over what was loaded
+	char spareState[sizeof(randState)];
+	if (!io->loading)
+		setstate(randState);
+	else if (io->buf != NULL)
+		initstate(1, spareState, sizeof(spareState));
+	stateArray(io, randState, sizeof(randState));
+	if (io->buf != NULL && io->loading)
+		setstate(randState);
+}
+
+// Function to give every job in a restored process table a worker again, since the ones that ran it went away
+// with the oss that took the checkpoint. The new worker starts the job's random generator and the CPU time it has
+// used over, so its -t limit counts from zero again. A job run in oss was restored with the rest of the state and
+// carries on exactly where it was
+void relaunchWorkers()
+{
+	for (int i = 0; i < tableSize; i++)
+	{
+		// Entries are allocated lowest first, so this takes entry i
+		slotAlloc(&slots);
+		processTable.exited[i] = 0;
+		if (!processTable.occupied[i])
+			continue;
+		if (!inProcess)
+			processTable.pid[i] = launchJob(i, processTable.job[i]);
+		cacheSlotText(i);
+	}
+	for (int i = 0; i < tableSize; i++)
+		if (!processTable.occupied[i])
+			slotFree(&slots, i);
+}
+
+// Function to spawn the next job into the first free process table entry and fill in its PCB at the current time
+// Returns its table index, for the caller to hand to a policy
+int spawnJob()
+{
+	// Take first free entry in process table for new child
+	int slot = slotAlloc(&slots);
+
+	// Real time when launch started, used to measure job launch latency
+	long long launchStartNs = realTimeNs();
+
+	pid_t childPid = launchJob(slot, total);
+
+	// Increment total created processes and running processes
+	total++;
+	running++;
+
+	// Update table with new child info
+	long long currTimeNs = clockNow(sysClock);
+	processTable.occupied[slot] = 1;
+	processTable.pid[slot] = childPid;
+	processTable.job[slot] = total - 1;
+	processTable.startNs[slot] = currTimeNs;
+	processTable.messagesSent[slot] = 0;
+	processTable.launchRealNs[slot] = realTimeNs() - launchStartNs;
+	cacheSlotText(slot);
+	processTable.serviceNs[slot] = 0;
+	processTable.eventWaitNs[slot] = 0;
+	processTable.blocked[slot] = 0;
+	processTable.blockedNs[slot] = 0;
+	processTable.exited[slot] = 0;
+	processTable.readyNs[slot] = currTimeNs;
+	return slot;
+}
+
+// Function to take every process that has passed its blocked time off the top of the blocked queue and put them
+// in dueBlocked, in the order they were blocked
+void takeDueBlocked(long long currTimeNs)
+{
+	dueBlocked.clear();
+	while (!blockedQueue.empty() && currTimeNs >= blockedQueue.front().wakeNs)
+	{
+		pop_heap(blockedQueue.begin(), blockedQueue.end(), greater<blockedEntry>());
+		dueBlocked.push_back(blockedQueue.back());
+		blockedQueue.pop_back();
+	}
+	sort(dueBlocked.begin(), dueBlocked.end(), [](const blockedEntry& a, const blockedEntry& b) { return a.seq < b.seq; });
+}
+
+// Function to update the PCB of a blocked process that has just been handed back to a policy
+void unblockJob(int bIndx, long long currTimeNs)
+{
+	processTable.readyNs[bIndx] = currTimeNs;
+
+	// Add time process actually spent blocked, from when it blocked until now, to its and the total blocked time
+	long long blockedForNs = currTimeNs - processTable.blockStartNs[bIndx];
+	processTable.blockedNs[bIndx] += blockedForNs;
+	totalBlockedTimeNs += blockedForNs;
+
+	// Reset process's values in PCB to reflect no longer being blocked
+	processTable.eventWaitNs[bIndx] = 0;
+	processTable.blocked[bIndx] = 0;
+
+	// Add additional overhead for blocked scheduling
+	addOverhead();
+	addOverhead();
+}
+
+// Function to dispatch the next process the policy picks, sending it its quantum and adding it to the in-flight list
+// Returns its table index, or -1 if no process is ready
+template <typename Policy>
+int dispatchNext(Policy& policy)
+{
+	// Ask the policy for the next process and the time quantum it will be given to run
+	int quantum;
+	int level;
+	int indx = policy.pick(clockNow(sysClock), &quantum, &level);
+	if (indx == -1)
+		return -1;
+	processTable.level[indx] = level;
+
+	// Record how long process waited in its queue, and its response time if this is its first dispatch
+	long long pickNs = clockNow(sysClock);
+	recordMetric(METRIC_QUEUE_WAIT, level, pickNs - processTable.readyNs[indx]);
+	if (processTable.messagesSent[indx] == 0)
+		recordMetric(METRIC_RESPONSE, level, pickNs - processTable.startNs[indx]);
+
+	// Call function to add scheduling overhead to OS 
+	addOverhead();
+
+	// When replaying, look up how this run of the job turned out when it was recorded
+	// A job with no runs left in the trace terminates, and a partly used quantum is scaled to the one given now
+	int scriptStatus = 0;
+	int scriptUsed = 0;
+	int recQuantum;
+	if (traceReplaying() && traceNextRun(processTable.job[indx], &scriptStatus, &recQuantum, &scriptUsed) == 0)
+	{
+		if (scriptStatus == 1)
+			scriptUsed = quantum;
+		else if (recQuantum != quantum && recQuantum > 0)
+			scriptUsed = (int)((long long)scriptUsed * quantum / recQuantum);
+	}
+	processTable.dispatchQuantum[indx] = quantum;
+
+	// Grant a run of quanta at once if the process will keep getting this one. Not while replaying, since
+	// each quantum then carries its own recorded outcome
+	int grant = grantMax > 1 && !traceReplaying() && policy.fixedQuantum(indx) ? grantMax : 1;
+
+	// Real time when dispatch started, used to measure transport round trip. A quantum left from the last grant
+	// sends nothing, so it has no round trip
+	processTable.dispatchRealNs[indx] = batchLeft[indx] > 0 ? DISPATCH_FROM_GRANT : realTimeNs();
+
+	// Send quantum to child process. Nothing is counted or logged for a worker that has already exited
+	int sent = sendQuantum(indx, quantum, grant, traceReplaying(), scriptStatus, scriptUsed);
+	if (sent == SEND_GONE)
+		processTable.dispatchRealNs[indx] = DISPATCH_WORKER_GONE;
+	else if (sent == SEND_OK)
+	{
+		msgsnt++; // Increment amount of messages sent
+		logPrintf("Dispatching process (index %d, queue level %d) with PID %d, time quantum %d at time %d:%d\n",
+				indx, processTable.level[indx], processTable.pid[indx], quantum, clockSec(clockNow(sysClock)), clockNano(clockNow(sysClock)));
+	}
+
+	// Track worker until it replies
+	inFlight[inFlightCount++] = indx;
+	return indx;
+}
+
+// Function to record a worker's reply: its round trip, and the run in the trace being recorded
+void noteReply(int indx, int status, int quanUsed)
+{
+	// Add round trip to total real time spent dispatching
+	// A worker's first dispatch also waits for it to exec and attach, so only later ones are measured
+	long long roundTripNs = realTimeNs() - processTable.dispatchRealNs[indx];
+	if (processTable.dispatchRealNs[indx] == DISPATCH_WORKER_GONE)
+	{
+		traceAdd(TRACE_RUN, processTable.job[indx], status, processTable.dispatchQuantum[indx], quanUsed);
+		return;
+	}
+	if (processTable.dispatchRealNs[indx] == DISPATCH_FROM_GRANT)
+		grantQuanta++;
+	else if (processTable.messagesSent[indx] > 0)
+	{
+		dispatchWallNs += roundTripNs;
+		dispatchCount++;
+		histRecord(&dispatchHist, roundTripNs);
+	}
+	else
+	{
+		// Job is launched once its first dispatch is answered
+		totalLaunchNs += processTable.launchRealNs[indx] + roundTripNs;
+		launchedJobs++;
+		histRecord(&launchHist, processTable.launchRealNs[indx] + roundTripNs);
+	}
+	processTable.messagesSent[indx]++;
+	traceAdd(TRACE_RUN, processTable.job[indx], status, processTable.dispatchQuantum[indx], quanUsed);
+}
+
+// Function to finish a run that has ended at the current time: bill it to the process, then terminate, block or
+// requeue the process with the policy it ran from
+template <typename Policy>
+void endRun(Policy& policy, int indx, int status, int quanUsed)
+{
+	policy.charge(indx, quanUsed, processTable.dispatchQuantum[indx]);
+
+	// Add quantum used to process's service time in PCB
+	processTable.serviceNs[indx] += quanUsed;
+
+	// Increment total service time in ns by the quantum used
+	totalServiceTimeNs += quanUsed;
+
+	// Determine if child sent 0, meaning child will terminate
+	if (status == 0 || quanUsed == 0)
+	{
+		// Calculate when process was forked
+		long long arrivalTimeNs = processTable.startNs[indx];
+		long long currTimeNs = clockNow(sysClock);
+		// Calculate process's turnaround time by finding difference between current time and time process forked
+		long long turnaroundNs = currTimeNs - arrivalTimeNs;
+		// Add to total turnaround time
+		totalTurnaroundTimeNs += turnaroundNs;
+
+		// Record process's times under the queue it finished in
+		long long serviceNs = processTable.serviceNs[indx];
+		recordMetric(METRIC_TURNAROUND, processTable.level[indx], turnaroundNs);
+		recordMetric(METRIC_WAIT, processTable.level[indx], turnaroundNs - serviceNs);
+		recordMetric(METRIC_BLOCKED, processTable.level[indx], processTable.blockedNs[indx]);
+
+		// Increment terminated processes
+		terminatedProcesses++;
+
+		// Child exits on its own and is reaped once oss sees it exit, pooled workers stay around for their next job
+		// Update process table to reflect terminated child
+		processTable.occupied[indx] = 0;
+		slotFree(&slots, indx);
+		markSlotChanged(indx);
+		// Decrement amount of processes currently running
+		running--;
+	}
+	else if (status == -1) // If worker sends -1, means it was blocked
+	{
+		// Randomly generate amount of time process will remain blocked, or take it from the trace being replayed
+		int blockSec;
+		int blockNs;
+		if (!traceReplaying() || traceNextBlock(processTable.job[indx], &blockSec, &blockNs) == -1)
+		{
+			blockSec = rand() % 6;
+			blockNs = (rand() % 1001) * 1000000;
+		}
+		traceAdd(TRACE_BLOCK, processTable.job[indx], 0, blockSec, blockNs);
+		// Record in PCB when process's block starts and ends
+		processTable.blockStartNs[indx] = clockNow(sysClock);
+		processTable.eventWaitNs[indx] = processTable.blockStartNs[indx] + (long long)blockSec * 1000000000 + blockNs;
+		// Mark process as blocked in PCB
+		processTable.blocked[indx] = 1;
+
+		// Add process to blocked queue, keyed by the time it is due to unblock
+		blockedEntry entry;
+		entry.wakeNs = processTable.eventWaitNs[indx];
+		entry.seq = blockedSeq++;
+		entry.indx = indx;
+		blockedQueue.push_back(entry);
+		push_heap(blockedQueue.begin(), blockedQueue.end(), greater<blockedEntry>());
+		// Increment amount of total blocked processes
+		blockedCount++;
+
+		// Additional overhead added for handling blocked process
+		addOverhead();
+		addOverhead();
+	}
+	else // Process did not finish
+	{
+		// Give process back to the policy, MLFQ puts it one queue lower than where it was scheduled from
+		queueCount[policy.requeue(indx, clockNow(sysClock))]++;
+		processTable.readyNs[indx] = clockNow(sysClock);
+	}
+}
+
+// Function to find the placement a -M name stands for. Returns -1 if there is none
+int placeKind(const char* name)
+{
+	for (int k = 0; k < 3; k++)
+		if (strcmp(name, placeNames[k]) == 0)
+			return k;
+	return -1;
+}
+
+// Function to choose the CPU a ready process goes on with placement kind
+int placeJob(int kind, int indx)
+{
+	if (kind == PLACE_HOME)
+		return processTable.cpu[indx];
+	if (kind == PLACE_RR)
+	{
+		int c = placeNext;
+		placeNext = (placeNext + 1) % cpus;
+		return c;
+	}
+	// Fewest processes ready or running, lowest CPU on a tie
+	int best = 0;
+	int bestLoad = simCpus[0].ready + (simCpus[0].running != -1);
+	for (int c = 1; c < cpus; c++)
+	{
+		int load = simCpus[c].ready + (simCpus[c].running != -1);
+		if (load < bestLoad)
+		{
+			best = c;
+			bestLoad = load;
+		}
+	}
+	return best;
+}
+
+// Function to move the next process of the CPU with the most ready into the ready queues of idle CPU c
+// What a policy knows of a process stays with the CPU it was on, so the process is admitted to c's policy as if it
+// had just been spawned there: MLFQ starts it in c's top queue, lottery with base tickets, and stride and cfs at
+// c's place in line. Returns 0 if no other CPU has a process ready
+template <typename Policy>
+int stealWork(vector<Policy>& policies, int c)
+{
+	int victim = -1;
+	for (int v = 0; v < cpus; v++)
+		if (v != c && simCpus[v].ready > 0 && (victim == -1 || simCpus[v].ready > simCpus[victim].ready))
+			victim = v;
+	if (victim == -1)
+		return 0;
+
+	long long nowNs = clockNow(sysClock);
+	int quantum;
+	int level;
+	int indx = policies[victim].pick(nowNs, &quantum, &level);
+	simCpus[victim].ready--;
+	queueCount[policies[c].admit(indx, nowNs)]++;
+	simCpus[c].ready++;
+	processTable.cpu[indx] = c;
+	simCpus[c].steals++;
+	logPrintf("CPU %d took process (index %d) from CPU %d at time %d:%d\n", c, indx, victim, clockSec(nowNs), clockNano(nowNs));
+	return 1;
+}
+
+// Function to run the simulation on the simulated CPUs of -M until every job is done. Each CPU gets its own policy,
+// copied from one that has not been initialized, so no two of them share any array
+template <typename Policy>
+void runCpus(vector<Policy>& policies, long long lastPrintNs, long long nSpawnT)
+{
+	for (int c = 0; c < cpus; c++)
+	{
+		policies[c].init(tableSize);
+		simCpus[c].running = -1;
+		simCpus[c].idleSinceNs = clockNow(sysClock);
+	}
+
+	while (total < maxTotal || running > 0)
+	{
+		// Terminate if a signal asked to
+		stopIfSignaled();
+		long long currTimeNs = clockNow(sysClock);
+
+		if (currTimeNs - lastPrintNs >= 500000000) // Determine if time of last print surpasssed .5 sec system time
+		{
+			printInfo(policies.data(), cpus);
+			lastPrintNs = currTimeNs;
+			statPhase(PHASE_PRINT);
+		}
+
+		// Real time the blocked queue scan started, only read when benchmarking
+		long long scanStartNs = benchMode ? realTimeNs() : 0;
+
+		// Hand every process that has passed its blocked time to the policy of the CPU it is placed on. One placed
+		// on another CPU than it was on is admitted there, as a stolen one is, and counted as an insertion like
+		// every admitted process
+		takeDueBlocked(currTimeNs);
+		for (size_t i = 0; i < dueBlocked.size(); i++)
+		{
+			int bIndx = dueBlocked[i].indx;
+			int c = placeJob(placeWake, bIndx);
+			if (c == processTable.cpu[bIndx])
+				policies[c].wake(bIndx, currTimeNs);
+			else
+				queueCount[policies[c].admit(bIndx, currTimeNs)]++;
+			simCpus[c].ready++;
+			processTable.cpu[bIndx] = c;
+			unblockJob(bIndx, currTimeNs);
+		}
+		if (benchMode)
+			histRecord(&tickHist, realTimeNs() - scanStartNs);
+		statPhase(PHASE_SCAN);
+
+		// Spawn a new child process once it is due, on the CPU it is placed on
+		currTimeNs = clockNow(sysClock);
+		if (currTimeNs >= nSpawnT && total < maxTotal && running < tableSize)
+		{
+			int slot = spawnJob();
+			int c = placeJob(placeNew, slot);
+			queueCount[policies[c].admit(slot, currTimeNs)]++;
+			simCpus[c].ready++;
+			processTable.cpu[slot] = c;
+			nSpawnT = currTimeNs + nextSpawnDelay(total, maxBetProcSec, maxBetProcNs);
+			statPhase(PHASE_SPAWN);
+		}
+
+		// Give every idle CPU its next process, taking one from another CPU if it has none ready
+		for (int c = 0; c < cpus; c++)
+		{
+			if (simCpus[c].running != -1)
+				continue;
+			if (simCpus[c].ready == 0 && (!cpuSteal || !stealWork(policies, c)))
+				continue;
+			int indx = dispatchNext(policies[c]);
+			simCpus[c].ready--;
+			currTimeNs = clockNow(sysClock);
+			simCpus[c].idleNs += currTimeNs - simCpus[c].idleSinceNs;
+			simCpus[c].running = indx;
+			simCpus[c].startNs = currTimeNs;
+			simCpus[c].dispatches++;
+			statPhase(PHASE_DISPATCH);
+		}
+
+		// Wait for every worker just dispatched, so the end of each run is known before the clock moves past it
+		while (inFlightCount > 0)
+		{
+			int status;
+			int quanUsed;
+			int indx = receiveAnyReply(&status, &quanUsed);
+			noteReply(indx, status, quanUsed);
+			simCpu* cpu = &simCpus[processTable.cpu[indx]];
+			cpu->status = status;
+			cpu->used = quanUsed;
+			cpu->endNs = cpu->startNs + quanUsed;
+			statPhase(PHASE_RECEIVE);
+		}
+
+		// Jump the clock to the next event: the earliest end of a run, the next unblock, spawn or status print
+		long long nextNs = lastPrintNs + 500000000;
+		for (int c = 0; c < cpus; c++)
+			if (simCpus[c].running != -1)
+				nextNs = min(nextNs, simCpus[c].endNs);
+		if (!blockedQueue.empty())
+			nextNs = min(nextNs, blockedQueue.front().wakeNs);
+		if (total < maxTotal && running < tableSize)
+			nextNs = min(nextNs, nSpawnT);
+		currTimeNs = clockNow(sysClock);
+		if (nextNs > currTimeNs)
+			clockAdvance(sysClock, nextNs - currTimeNs);
+
+		// Finish every run that has ended by now, earliest first
+		while (true)
+		{
+			int c = -1;
+			for (int i = 0; i < cpus; i++)
+				if (simCpus[i].running != -1 && simCpus[i].endNs <= clockNow(sysClock) && (c == -1 || simCpus[i].endNs < simCpus[c].endNs))
+					c = i;
+			if (c == -1)
+				break;
+			simCpu* cpu = &simCpus[c];
+			int indx = cpu->running;
+			currTimeNs = clockNow(sysClock);
+			logPrintf("Receiving message from worker (index %d PID %d) on CPU %d at time %d:%d\n",
+					indx, processTable.pid[indx], c, clockSec(currTimeNs), clockNano(currTimeNs));
+			cpu->busyNs += cpu->used;
+			cpu->running = -1;
+			cpu->idleSinceNs = cpu->endNs;
+			endRun(policies[c], indx, cpu->status, cpu->used);
+			// A process that used its whole quantum went back in the queues of the CPU that ran it
+			if (processTable.occupied[indx] && !processTable.blocked[indx])
+				cpu->ready++;
+			statPhase(PHASE_ACCOUNT);
+		}
+	}
+
+	// Every CPU is idle from the end of its last run, and the machine's idle time is theirs added up
+	for (int c = 0; c < cpus; c++)
+	{
+		simCpus[c].idleNs += clockNow(sysClock) - simCpus[c].idleSinceNs;
+		totalIdleTimeNs += simCpus[c].idleNs;
+	}
+}
+
+// Function to run the simulation until every job is done, with the given scheduling policy
+// Templated on the policy so each one gets its own copy of the main loop with its calls inlined
+template <typename Policy>
+void runScheduler(Policy& policy)
+{
+	// With -M, every CPU gets its own copy of the policy, taken before it is initialized
+	vector<Policy> cpuPolicies;
+	if (cpuModel)
+		cpuPolicies.assign(cpus, policy);
+
+	// Give policy room for every table entry
+	policy.init(tableSize);
+	readyLevels = policy.levels();
+
+	// Allocate histograms, one for all queues and one for each queue per metric
+	metricHists = new latencyHist[METRICS * (readyLevels + 1)];
+	for (int i = 0; i < METRICS * (readyLevels + 1); i++)
+		histInit(&metricHists[i]);
+	// Make room in the status print for the distributions
+	if (histAtPrint)
+	{
+		delete[] snapBuf;
+		snapCap += latencyTextMax();
+		snapBuf = new char[snapCap];
+	}
+
+	// Variable to track last printed time in ns
+	long long lastPrintNs = clockNow(sysClock);
+
+	// Initialize process table, all values set to 0
+	for (int i = 0; i < tableSize; i++)
+	{
+		processTable.occupied[i] = 0;
+		processTable.serviceNs[i] = 0;
+		processTable.eventWaitNs[i] = 0;
+		processTable.blocked[i] = 0;
+		processTable.exited[i] = 0;
+	}
+
+	// Variable to hold current time in ns
+	long long currTimeNs = clockNow(sysClock);
+	// Calculate next spawn time in ns by adding random delay (between 0 and the max allowed) to current time
+	long long nSpawnT = currTimeNs + nextSpawnDelay(0, maxBetProcSec + 1, maxBetProcNs + 1);
+
+	// Carry on from the checkpoint given with -X
+	if (restartState != NULL)
+	{
+		stateIO io = {(char*)restartState, 0, 1};
+		transferState(policy, &io, &lastPrintNs, &nSpawnT);
+		if (io.len != restartSize)
+		{
+			fprintf(stderr, "Checkpoint file %s was not written by a compatible oss.\n", restartPath);
+			exit(1);
+		}
+		relaunchWorkers();
+		currTimeNs = clockNow(sysClock);
+		printf("Restarted from checkpoint %s at time %d:%d with %d of %d processes launched\n",
+				restartPath, clockSec(currTimeNs), clockNano(currTimeNs), total, maxTotal);
+		logPrintf("Restarted from checkpoint %s at time %d:%d with %d of %d processes launched\n",
+				restartPath, clockSec(currTimeNs), clockNano(currTimeNs), total, maxTotal);
+	}
+
+	// Make room for two checkpoints in the file given with -x. Walking the state without copying it gives its
+	// size, which never changes since every table is walked at full size
+	if (ckptPath != NULL)
+	{
+		stateIO io = {NULL, 0, 0};
+		transferState(policy, &io, &lastPrintNs, &nSpawnT);
+		if (ckptOpen(ckptPath, io.len) == -1)
+		{
+			fprintf(stderr, "Failed to create checkpoint file %s.\n", ckptPath);
+			exit(1);
+		}
+		nextCkptNs = realTimeNs() + ckptIntervalNs;
+	}
+
+	// Simulate several CPUs with their own queues if -M was given
+	if (cpuModel)
+	{
+		runCpus(cpuPolicies, lastPrintNs, nSpawnT);
+		return;
+	}
+
+	// Loop that will continue until amount of maxTotal total child processes is reached or until running processes is 0
+	// Ensures only maxTotal total processes are able to run, and that no processses are still running when the loop ends
+	phaseMarkNs = realTimeNs();
+	while (total < maxTotal ||  running > 0)
+	{
+		// Terminate if a signal asked to
+		stopIfSignaled();
+
+		// Write a checkpoint once one is due. It can only be taken with no worker in flight, so with several CPUs
+		// no new quantum is dispatched until those in flight have replied
+		int ckptDue = ckptPath != NULL && realTimeNs() >= nextCkptNs;
+		if (ckptDue && inFlightCount == 0)
+		{
+			stateIO io = {ckptSlot(), 0, 0};
+			transferState(policy, &io, &lastPrintNs, &nSpawnT);
+			ckptCommit();
+			checkpoints++;
+			nextCkptNs = realTimeNs() + ckptIntervalNs;
+			ckptDue = 0;
+		}
+
+		// Update system clock
+		incrementClock();
+		long long currTimeNs = clockNow(sysClock);
+
+		if (currTimeNs - lastPrintNs >= 500000000) // Determine if time of last print surpasssed .5 sec system time
+		{
+			// If true, print table and MLFQ info and update time of last print
+			printInfo(&policy, 1);
+			lastPrintNs = currTimeNs;
+			statPhase(PHASE_PRINT);
+		}
+
+		// Real time the blocked queue scan started, only read when benchmarking
+		long long scanStartNs = benchMode ? realTimeNs() : 0;
+
+		// Take every process that has passed its blocked time off the top of the blocked queue
+		takeDueBlocked(currTimeNs);
+		for (size_t i = 0; i < dueBlocked.size(); i++)
+		{
+			// Hand blocked process back to the policy, which puts it in the top priority queue
+			policy.wake(dueBlocked[i].indx, currTimeNs);
+			unblockJob(dueBlocked[i].indx, currTimeNs);
+		}
+		if (benchMode)
+			histRecord(&tickHist, realTimeNs() - scanStartNs);
+		statPhase(PHASE_SCAN);
+
+		// Update variable holding clock time in ns to system's current time in ns
+		currTimeNs = clockNow(sysClock);
+
+		// Determine if a new child process can be spawned
+		// Must be greater than next spawn time, less than total process allowed (maxTotal), and less than simultanous processes allowed (tableSize)
+		if (currTimeNs >= nSpawnT && total < maxTotal  && running < tableSize)
+		{
+			// Increment clock
+			incrementClock();
+
+			int slot = spawnJob();
+			currTimeNs = clockNow(sysClock);
+			// Hand process to the policy since it is ready to be scheduled, and count insertions to the queue it went in
+			queueCount[policy.admit(slot, currTimeNs)]++;
+
+			// Calculate next randomly generated spawn time in ns
+			nSpawnT = currTimeNs + nextSpawnDelay(total, maxBetProcSec, maxBetProcNs);
+			statPhase(PHASE_SPAWN);
+		}
+
+
+		// Dispatch ready processes until every simulated CPU has a worker in flight
+		while (inFlightCount < cpus && !ckptDue)
+		{
+			// Send the next process the policy picks its quantum, if any is ready
+			if (dispatchNext(policy) == -1)
+				break;
+			statPhase(PHASE_DISPATCH);
+		}
+
+		if (inFlightCount > 0)
+		{
+			// Wait for whichever in-flight worker replies first
+			int status;
+			int quanUsed;
+			int indx = receiveAnyReply(&status, &quanUsed);
+			statPhase(PHASE_RECEIVE);
+
+			noteReply(indx, status, quanUsed);
+			// Update variable holding clock time in ns to system's current time in ns
+			currTimeNs = clockNow(sysClock);
+			
+			logPrintf("Receiving message from worker (index %d PID %d) at time %d:%d\n",
+					indx, quanUsed, clockSec(currTimeNs), clockNano(currTimeNs));
+
+			// Increment system clock by that time in ns, and bill it to the process
+			clockAdvance(sysClock, quanUsed);
+			endRun(policy, indx, status, quanUsed);
+			statPhase(PHASE_ACCOUNT);
+		}
+		else
+		{
+			// No process is ready, simulate cpu idle time and increment total idle time by this amount in ns
+			incrementClock();
+			totalIdleTimeNs += 10000000;
+
+			if (eventMode)
+			{
+				// Nothing can change until the next spawn, unblock or print, so skip every idle iteration before it
+				// at once. The clock and idle time end up exactly where tick mode would have left them
+				long long nowNs = clockNow(sysClock);
+				// Next status print
+				long long skip = idleItersBefore(nowNs, lastPrintNs + 500000000);
+				// Earliest unblock
+				if (!blockedQueue.empty())
+					skip = min(skip, idleItersBefore(nowNs, blockedQueue.front().wakeNs));
+				// Next spawn, only an event if another child is allowed to be spawned
+				if (total < maxTotal && running < tableSize)
+					skip = min(skip, idleItersBefore(nowNs, nSpawnT));
+
+				clockAdvance(sysClock, skip * 20000000);
+				totalIdleTimeNs += skip * 10000000;
 			}
+			statPhase(PHASE_IDLE);
+		}		
+			
+
+	}
+}
 
-			// Increment total service time in ns by the quantum used
-			totalServiceTimeNs += quanUsed;
-
-                        // Determine if child sent 0, meaning child will terminate
-                        if (strcmp(rcvbuf.strData, "0") == 0 || rcvbuf.intData == 0)
-                        {
-				// Calculate when process was forked
-				long long arrivalTimeNs = ((long long) processTable[indx].startSeconds * 1000000000) + processTable[indx].startNano;
-				currTimeNs = ((long long)shm_ptr[0] * 1000000000) + shm_ptr[1];
-				// Calculate process's turnaround time by finding difference between current time and time process forked
-				long long turnaroundNs = currTimeNs - arrivalTimeNs;
-				// Add to total turnaround time
-				totalTurnaroundTimeNs += turnaroundNs;
-
-				// Increment terminated processes
-				terminatedProcesses++;
-
-				// Wait for child to terminate
-                                waitpid(childP, NULL, 0);
-				// Update process table to reflect terminated child
-                                processTable[indx].occupied = 0;
-                                // Decrement amount of processes currently running
-				running--;      
-					
+int main(int argc, char* argv[])
+{
+	// Real time oss started, used to report total wall time
+	long long startRealNs = realTimeNs();
+
+	const char optstr[] = "hn:s:t:i:fmc:ea:pdbw:r:R:P:L:SHg:l:k:o:x:X:Iz:A:M:"; // Options h, n, s, t, i, f, m, c, e, a, p, d, b, w, r, R, P, L, S, H, g, l, k, o, x, X, I, z, A, M
+	int useStats = 0; // Set when -S is given
+	int totalGiven = 0; // Set when -n is given
+	int seedGiven = 0; // Set when -z is given
+	int cpusGiven = 0; // Set when -c is given
+	int opt;
+
+	// Parse command line options
+	while ((opt = getopt(argc, argv, optstr)) != -1)
+	{
+		switch (opt)
+		{
+			case 'h':
+				printf("Usage: %s [-h] [-n N] [-s M] [-t T] [-i I] [-f] [-d] [-m] [-c K] [-e] [-a A] [-p] [-b] [-w T,B] [-r F | -R F] [-P policy] [-L list] [-A pct] [-M P[:new[,wake[,nosteal]]]] [-S] [-H] [-g G] [-l load[:D]] [-k cpus] [-o cpu] [-x F[:ms]] [-X F] [-I] [-z seed]\n", argv[0]);
+				printf("  -n N  Total child processes (default: 100)\n");
+				printf("  -s M  Max simultaneous workers, also the process table size (default: 18)\n");
+				printf("  -t T  Most CPU time in seconds a job may use before it terminates, 0 for no limit (default: 0)\n");
+				printf("  -i I  Least simulated time in ns between two spawns (default: 0)\n");
+				printf("  -f    Log output to ossLog.txt\n");
+				printf("  -d    With -f, drop log lines instead of waiting when the log buffer is full\n");
+				printf("  -m    Dispatch through shared-memory mailboxes instead of the message queue\n");
+				printf("  -c K  Keep up to K workers dispatched at once (default: 1)\n");
+				printf("  -M P[:new,wake[,nosteal]]  Simulate P CPUs running at once, each with its own ready queues. New processes go\n");
+				printf("        on the least loaded CPU or each in turn (least or rr, default: least), unblocked ones back on the CPU that\n");
+				printf("        last ran them or as new ones do (home, least or rr, default: home). Idle CPUs steal unless nosteal is given\n");
+				printf("  -e    Jump the clock to the next event when idle instead of ticking\n");
+				printf("  -a A  Terminate everything after A seconds of real time, 0 for no limit (default: 3)\n");
+				printf("  -p    Start one worker per table entry up front and reuse it for job after job\n");
+				printf("  -I    Run jobs inside oss instead of in workers, same results as -p with the same -z\n");
+				printf("  -z seed  Seed job random numbers with -p and -I from seed instead of oss's PID\n");
+				printf("  -b    Print a machine-readable line of real-time benchmark results at exit\n");
+				printf("  -w T,B  Workload mix: percent of quanta that end in termination, and in blocking (default: 20,30)\n");
+				printf("  -r F  Record every random decision of this run to trace file F\n");
+				printf("  -R F  Replay the decisions recorded in trace file F instead of drawing them\n");
+				printf("  -P policy  Scheduling policy (default: mlfq):\n");
+				printf("        mlfq       Multi-level feedback queue, three queues unless -L is given\n");
+				printf("        boost[:ms] MLFQ that moves every process back to the top queue every ms of system time (default: 1000)\n");
+				printf("        lottery    Lottery scheduling with compensation tickets\n");
+				printf("        stride     Stride scheduling by time used\n");
+				printf("        cfs        Least virtual runtime first, with a time slice shared among ready processes\n");
+				printf("  -L list  Comma-separated time quantum of each MLFQ queue in ms, up to %d queues (default: 10,20,40)\n", MAX_LEVELS);
+				printf("  -A pct  Retune each MLFQ queue's quantum as the run goes, so pct percent of its runs end within quantum\n");
+				printf("  -S    Time each phase of the main loop and publish live statistics for ossstat\n");
+				printf("  -H    Add latency percentiles to every status print, not only the final statistics\n");
+				printf("  -g G  Grant up to G quanta per message to a process whose quantum will not change (default: 1)\n");
+				printf("  -l load[:D]  Make workers do real work for 1/D of the simulated time they use (default D: 100):\n");
+				printf("        spin       Integer arithmetic that stays in registers\n");
+				printf("        mem        Pointer chase through a %d MB buffer per worker\n", LOAD_MEM_BYTES / (1024 * 1024));
+				printf("  -k cpus  Pin the worker of table entry i to the i-th CPU of a list such as 0,2-5, wrapping around\n");
+				printf("  -o cpu   Pin oss to a CPU\n");
+				printf("  -x F[:ms]  Checkpoint the simulation to file F every ms of real time (default: 1000)\n");
+				printf("  -X F  Restart from the newest checkpoint in file F, with the -n, -s, -t, -i, -c, -P, -L, -A, -w, -e, -I and -z it was taken with\n");
+				printf("        Jobs in workers start their random numbers and -t CPU time over, jobs run with -I carry on exactly\n");
+				exit(0);
+			case 'm':
+				useMailbox = 1;
+				break;
+			case 'e':
+				eventMode = 1;
+				break;
+			case 'c':
+				cpus = atoi(optarg);
+				cpusGiven = 1;
+				break;
+			case 'M':
+			{
+				// Number of CPUs, optionally followed by where new and unblocked processes go and whether to steal
+				char newName[8] = "least";
+				char wakeName[8] = "home";
+				char stealName[8] = "steal";
+				cpuModel = 1;
+				cpus = 0;
+				sscanf(optarg, "%d:%7[^,],%7[^,],%7s", &cpus, newName, wakeName, stealName);
+				placeNew = placeKind(newName);
+				placeWake = placeKind(wakeName);
+				cpuSteal = strcmp(stealName, "steal") == 0;
+				if (placeNew == -1 || placeNew == PLACE_HOME || placeWake == -1 || (!cpuSteal && strcmp(stealName, "nosteal") != 0))
+				{
+					fprintf(stderr, "-M expects CPUs[:new[,wake[,nosteal]]], new is least or rr, wake is home, least or rr, such as 4:rr,home\n");
+					exit(1);
+				}
+				break;
 			}
-			else if (strcmp(rcvbuf.strData, "-1") == 0) // If worker sends -1, means it was blocked
+			case 'n':
+				maxTotal = atoi(optarg);
+				totalGiven = 1;
+				break;
+			case 's':
+				tableSize = atoi(optarg);
+				break;
+			case 't':
+				runLimitNs = (long long)(atof(optarg) * 1e9);
+				break;
+			case 'i':
+				minSpawnGapNs = atoll(optarg);
+				break;
+			case 'a':
+				realTimeLimit = atoi(optarg);
+				break;
+			case 'p':
+				usePool = 1;
+				break;
+			case 'I':
+				inProcess = 1;
+				break;
+			case 'z':
+				jobSeedBase = (unsigned int)strtoul(optarg, NULL, 10);
+				seedGiven = 1;
+				break;
+			case 'f':
+				logToFile = 1;
+				break;
+			case 'd':
+				dropLog = 1;
+				break;
+			case 'b':
+				benchMode = 1;
+				break;
+			case 'S':
+				useStats = 1;
+				break;
+			case 'H':
+				histAtPrint = 1;
+				break;
+			case 'g':
+				grantMax = atoi(optarg);
+				break;
+			case 'l':
 			{
-				// Randomly generate amount of time process will remain blocked 
-				int blockSec = rand() % 6;
-				int blockNs = (rand() % 1001) * 1000000;
-				// Update process wait time in PCB
-				processTable[indx].eventWaitSec += blockSec;
-				processTable[indx].eventWaitNano += blockNs;
-				if(processTable[indx].eventWaitNano >= 1000000000)
+				// Load name, optionally followed by :D
+				char name[16];
+				loadDiv = 100;
+				if (sscanf(optarg, "%15[^:]:%d", name, &loadDiv) < 1)
+					name[0] = '\0';
+				if (strcmp(name, "spin") == 0)
+					loadKind = LOAD_SPIN;
+				else if (strcmp(name, "mem") == 0)
+					loadKind = LOAD_MEM;
+				else if (strcmp(name, "none") == 0)
+					loadKind = LOAD_NONE;
+				else
 				{
-					// Adjust values if ns overflows to seconds
-					processTable[indx].eventWaitSec += processTable[indx].eventWaitNano / 1000000000;
-					processTable[indx].eventWaitNano %= 1000000000;
+					fprintf(stderr, "-l must be one of spin[:D], mem[:D] or none\n");
+					exit(1);
 				}
-				// Mark process as blocked in PCB
-				processTable[indx].blocked = 1;
-
-				// Add process to blocked queue
-				blockedQueue.push(indx);
-				// Increment amount of total blocked processes
-				blockedCount++;
-				// Add process's blocked time to total time blocked in ns
-				totalBlockedTimeNs += ((long long)blockSec * 1000000000) + blockNs;
-
-				// Additional overhead added for handling blocked process
-				addOverhead();
-				addOverhead();
+				break;
 			}
-
-			else // Process did not finish
-                        {
-				// Add process to one queue lower than where it was scheduled from
-                                if (currQueue == &rQueue0)
-				{	
-					rQueue1.push(indx);
-					q1Count++;
+			case 'k':
+				if (parseCpuList(optarg) == -1)
+				{
+					fprintf(stderr, "-k expects a list of CPUs oss may run on, such as 0,2-5\n");
+					exit(1);
+				}
+				break;
+			case 'o':
+				ossCpu = atoi(optarg);
+				break;
+			case 'r':
+				recordPath = optarg;
+				break;
+			case 'R':
+				replayPath = optarg;
+				break;
+			case 'x':
+			{
+				// File name, optionally followed by :ms
+				ckptPath = optarg;
+				char* colon = strrchr(optarg, ':');
+				if (colon != NULL)
+				{
+					char* end;
+					long ms = strtol(colon + 1, &end, 10);
+					if (end == colon + 1 || *end != '\0' || ms < 1)
+					{
+						fprintf(stderr, "-x expects a file name, optionally followed by :ms of at least 1, such as ckpt.bin:500\n");
+						exit(1);
+					}
+					*colon = '\0';
+					ckptIntervalNs = ms * 1000000LL;
+				}
+				break;
+			}
+			case 'X':
+				restartPath = optarg;
+				break;
+			case 'P':
+			{
+				// Policy name, optionally followed by :N
+				char name[16];
+				policyParam = 0;
+				if (sscanf(optarg, "%15[^:]:%d", name, &policyParam) < 1)
+					name[0] = '\0';
+				if (strcmp(name, "mlfq") == 0)
+					policyKind = POLICY_MLFQ;
+				else if (strcmp(name, "boost") == 0)
+					policyKind = POLICY_BOOST;
+				else if (strcmp(name, "lottery") == 0)
+					policyKind = POLICY_LOTTERY;
+				else if (strcmp(name, "stride") == 0)
+					policyKind = POLICY_STRIDE;
+				else if (strcmp(name, "cfs") == 0)
+					policyKind = POLICY_CFS;
+				else
+				{
+					fprintf(stderr, "-P must be one of mlfq, boost[:ms], lottery, stride or cfs\n");
+					exit(1);
+				}
+				break;
+			}
+			case 'L':
+			{
+				// Read each quantum in ms, checking it is a whole number of ms that fits in an int of ns
+				numLevels = 0;
+				levelsGiven = 1;
+				char* item = optarg;
+				while (*item != '\0')
+				{
+					char* end;
+					long ms = strtol(item, &end, 10);
+					if (end == item || (*end != ',' && *end != '\0') || ms < 1 || ms > 2000 || numLevels == MAX_LEVELS)
+					{
+						fprintf(stderr, "-L expects 1 to %d comma-separated quanta between 1 and 2000 ms, such as 10,20,40\n", MAX_LEVELS);
+						exit(1);
+					}
+					levelQuanta[numLevels++] = (int)ms * 1000000;
+					item = *end == ',' ? end + 1 : end;
 				}
-                                else if (currQueue == &rQueue1) 
+				if (numLevels == 0)
 				{
-					rQueue2.push(indx);
-					q2Count++;
+					fprintf(stderr, "-L expects 1 to %d comma-separated quanta between 1 and 2000 ms, such as 10,20,40\n", MAX_LEVELS);
+					exit(1);
 				}
-                                else
-				{	
-					rQueue2.push(indx);
-					q2Count++;
+				break;
+			}
+			case 'A':
+				adaptPct = atoi(optarg);
+				if (adaptPct < 1 || adaptPct > 99)
+				{
+					fprintf(stderr, "-A expects a percentage between 1 and 99, such as 80\n");
+					exit(1);
 				}
-                        }
+				break;
+			case 'w':
+				if (sscanf(optarg, "%d,%d", &termPct, &blockPct) != 2)
+				{
+					fprintf(stderr, "-w expects two percentages, such as 20,30\n");
+					exit(1);
+				}
+				break;
+			default:
+				break;
+		}
+	}
 
+	// Take the options the checkpoint was taken with, so the checks below apply to them
+	if (restartPath != NULL)
+	{
+		if (ckptLoad(restartPath, &restartState, &restartSize) == -1)
+		{
+			fprintf(stderr, "No complete checkpoint found in %s.\n", restartPath);
+			exit(1);
 		}
-		else
+		stateIO io = {(char*)restartState, 0, 1};
+		transferConfig(&io);
+		levelsGiven = 0;
+		seedGiven = 1;
+	}
+
+	// Check limits now that every option is known
+	if (tableSize < 1 || maxTotal < 0 || realTimeLimit < 0 || runLimitNs < 0 || minSpawnGapNs < 0)
+	{
+		fprintf(stderr, "-s must be at least 1, -n, -a, -t and -i can not be negative\n");
+		exit(1);
+	}
+	if (cpus < 1 || cpus > tableSize)
+	{
+		fprintf(stderr, "-c and the CPUs of -M must be between 1 and %d\n", tableSize);
+		exit(1);
+	}
+	if (loadDiv < 1 || loadDiv > 1000000)
+	{
+		fprintf(stderr, "-l divisor must be between 1 and 1000000\n");
+		exit(1);
+	}
+	if (grantMax < 1 || grantMax > 1000)
+	{
+		fprintf(stderr, "-g must be between 1 and 1000\n");
+		exit(1);
+	}
+	if (termPct < 0 || blockPct < 0 || termPct + blockPct > 100)
+	{
+		fprintf(stderr, "-w percentages can not be negative or add up to more than 100\n");
+		exit(1);
+	}
+	if ((levelsGiven || adaptPct > 0) && policyKind != POLICY_MLFQ && policyKind != POLICY_BOOST)
+	{
+		fprintf(stderr, "-L and -A only apply to the mlfq and boost policies\n");
+		exit(1);
+	}
+	if (recordPath != NULL && replayPath != NULL)
+	{
+		fprintf(stderr, "-r and -R can not be used together\n");
+		exit(1);
+	}
+	if ((ckptPath != NULL || restartPath != NULL) && (recordPath != NULL || replayPath != NULL))
+	{
+		fprintf(stderr, "-x and -X can not be used with -r or -R\n");
+		exit(1);
+	}
+
+	// Each CPU's policy would pick up a retuned quantum only when it next charges a run at that queue, so CPUs
+	// would hand out different quanta for the same queue. A process stolen or woken on another CPU would still be
+	// answered from a grant its worker ran under the old CPU's queue
+	if (cpuModel && (cpusGiven || ckptPath != NULL || restartPath != NULL || adaptPct > 0 || grantMax > 1))
+	{
+		fprintf(stderr, "-M sets the number of CPUs itself and can not be used with -c, -x, -X, -A or -g\n");
+		exit(1);
+	}
+
+	if (inProcess && (usePool || useMailbox || loadKind != LOAD_NONE || workerCpuCount > 0))
+	{
+		fprintf(stderr, "-I runs jobs without workers, so it can not be used with -p, -m, -l or -k\n");
+		exit(1);
+	}
+	if (!seedGiven)
+		jobSeedBase = (unsigned int)getpid();
+
+	// Keep rand()'s state in randState. Seeding with 1 gives the same numbers rand() gives when never seeded
+	initstate(1, randState, sizeof(randState));
+
+	// Pin oss, then measure the load on the CPU it will run on before any worker competes with it
+	if (ossCpu >= 0)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (ossCpu < CPU_SETSIZE)
+			CPU_SET(ossCpu, &set);
+		if (ossCpu >= CPU_SETSIZE || sched_setaffinity(0, sizeof(set), &set) == -1)
 		{
-			// No process is ready, simulate cpu idle time and increment total idle time by this amount in ns
-			incrementClock();
-			totalIdleTimeNs += 10000000;
-		}		
-			
+			fprintf(stderr, "Failed to pin oss to CPU %d.\n", ossCpu);
+			exit(1);
+		}
+	}
+	if (loadKind != LOAD_NONE)
+	{
+		loadUnitsPerSec = loadCalibrate(loadKind) * 1000 / loadDiv;
+		loadFree();
+	}
+
+	// Map trace to replay. Unless -n is given, replay every job in it
+	if (replayPath != NULL)
+	{
+		int traceJobs = traceReplayOpen(replayPath);
+		if (traceJobs == -1)
+		{
+			fprintf(stderr, "Failed to open trace file %s.\n", replayPath);
+			exit(1);
+		}
+		if (!totalGiven)
+			maxTotal = traceJobs;
+		else if (maxTotal > traceJobs)
+		{
+			fprintf(stderr, "-n can not be more than the %d jobs in trace file %s\n", traceJobs, replayPath);
+			exit(1);
+		}
+	}
+	if (recordPath != NULL && traceRecordOpen(recordPath) == -1)
+	{
+		fprintf(stderr, "Failed to create trace file %s.\n", recordPath);
+		exit(1);
+	}
+
+	
+
+	// Signal that will terminate program after realTimeLimit sec (real time)
+	signal(SIGALRM, signal_handler);
+	alarm(realTimeLimit);
+	// Workers are in their own process group, so the terminal's interrupt only reaches oss, which passes it on
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	// Create message queue and reply queue. Both are private to this run and workers are given their IDs, so any
+	// number of runs can share a directory without seeing each other's messages
+	if ((msqid = msgget(IPC_PRIVATE, PERMS | IPC_CREAT)) == -1 || (rmsqid = msgget(IPC_PRIVATE, PERMS | IPC_CREAT)) == -1)
+	{
+		perror("msgget in parent\n");
+		exit(1);
+	}
+
+	printf("Message queue set up\n");
+
+	// Open log file only if -f was given
+	if (logToFile && logOpen("ossLog.txt", dropLog, restartPath != NULL) == -1)
+	{
+		fprintf(stderr, "Failed to open log file.\n");
+		return EXIT_FAILURE;
+	}
+
+	// Set up shared memory for clock
+	shareMem();
 
+	// Set up mailboxes if mailbox transport was selected
+	if (useMailbox)
+		mailboxMem();
+
+	// Watch for worker exits. Each worker holds a pidfd, so allow as many open files as the hard limit does
+	struct rlimit files;
+	if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max)
+	{
+		files.rlim_cur = files.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &files);
+	}
+	lifeEpoll = epoll_create1(EPOLL_CLOEXEC);
+	watches.reserve(tableSize);
+	freeWatches.reserve(tableSize);
+	if (lifeEpoll == -1)
+	{
+		perror("epoll_create1 failed");
+		exit(1);
+	}
+	struct sigaction childAction;
+	memset(&childAction, 0, sizeof(childAction));
+	childAction.sa_handler = childHandler;
+	childAction.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+	sigemptyset(&childAction.sa_mask);
+	sigaction(SIGCHLD, &childAction, NULL);
+
+	// Set up live statistics if -S was given
+	if (useStats)
+	{
+		statsMem();
+		logTimeCalls();
+	}
+
+	// Allocate memory for process table based on max simultaneous processes
+	processTable.occupied = new int[tableSize]();
+	processTable.pid = new pid_t[tableSize]();
+	processTable.startNs = new long long[tableSize]();
+	processTable.messagesSent = new int[tableSize]();
+	processTable.serviceNs = new long long[tableSize]();
+	processTable.eventWaitNs = new long long[tableSize]();
+	processTable.blockStartNs = new long long[tableSize]();
+	processTable.blocked = new int[tableSize]();
+	processTable.launchRealNs = new long long[tableSize]();
+	processTable.level = new int[tableSize]();
+	processTable.dispatchRealNs = new long long[tableSize]();
+	processTable.job = new int[tableSize]();
+	processTable.dispatchQuantum = new int[tableSize]();
+	processTable.readyNs = new long long[tableSize]();
+	processTable.blockedNs = new long long[tableSize]();
+	processTable.exited = new int[tableSize]();
+	processTable.cpu = new int[tableSize]();
+	slotMapInit(&slots, tableSize);
+	// Allocate list of in-flight workers, one entry per simulated CPU
+	inFlight = new int[cpus];
+	if (cpuModel)
+		simCpus = new simCpu[cpus]();
+	// Allocate what is left of each slot's last grant
+	batchLeft = new int[tableSize]();
+	batchStatus = new int[tableSize];
+	batchUsed = new int[tableSize];
+	batchQuantum = new int[tableSize];
+	// Reserve room for every table entry so blocking and unblocking never allocate
+	dueBlocked.reserve(tableSize);
+	blockedQueue.reserve(tableSize);
+
+	// Allocate status print buffers: header and queue labels, plus one table line and one queue entry per table entry
+	slotTexts = new slotText[tableSize];
+	tableText = new char[(size_t)tableSize * sizeof(slotTexts[0].line)];
+	tableSpare = new char[(size_t)tableSize * sizeof(slotTexts[0].line)];
+	tableLineLen = new int[tableSize]();
+	tableLenTree = new int[tableSize + 1]();
+	changedSlots = new int[tableSize];
+	slotChanged = new char[tableSize]();
+	snapCap = 512 + MAX_LEVELS * (cpuModel ? cpus * 24 : 16) + tableSize * (int)(sizeof(slotTexts[0].line) + sizeof(slotTexts[0].token));
+	snapBuf = new char[snapCap];
+
+	// Start pooled workers once, before the simulation begins
+	if (usePool)
+		startPool();
+	// Or make room for jobs run in oss
+	if (inProcess)
+	{
+		inJobs = new jobState[tableSize]();
+		inMix.termPct = termPct;
+		inMix.blockPct = blockPct;
+		inMix.runLimitNs = runLimitNs;
+	}
+
+	if (adaptPct > 0)
+		tunerInit(&tuner, adaptPct, levelQuanta, numLevels);
+
+	// Run the simulation with the scheduling policy chosen by -P
+	switch (policyKind)
+	{
+		case POLICY_BOOST:
+		{
+			mlfqPolicy policy(levelQuanta, numLevels, policyParam > 0 ? (long long)policyParam * 1000000 : 1000000000LL,
+					adaptPct > 0 ? &tuner : NULL);
+			runScheduler(policy);
+			break;
+		}
+		case POLICY_LOTTERY:
+		{
+			lotteryPolicy policy(baseq);
+			runScheduler(policy);
+			break;
+		}
+		case POLICY_STRIDE:
+		{
+			stridePolicy policy(baseq);
+			runScheduler(policy);
+			break;
+		}
+		case POLICY_CFS:
+		{
+			cfsPolicy policy(4 * baseq, baseq);
+			runScheduler(policy);
+			break;
+		}
+		default:
+		{
+			mlfqPolicy policy(levelQuanta, numLevels, 0, adaptPct > 0 ? &tuner : NULL);
+			runScheduler(policy);
+			break;
+		}
 	}
 
+	// Every job is done, let pooled workers exit, then reap every worker not reaped yet
+	if (usePool)
+		stopPool();
+	reapAll();
+	close(lifeEpoll);
+
+	// Context switches of oss and of every worker it has waited for, to show how much they competed for CPUs
+	struct rusage ossUsage, workerUsage;
+	getrusage(RUSAGE_SELF, &ossUsage);
+	getrusage(RUSAGE_CHILDREN, &workerUsage);
+	int showLoad = loadKind != LOAD_NONE || workerCpuCount > 0 || ossCpu >= 0;
+
 	// Print total amounts
 	printf("Total processes launched: %d\n", total);
 	printf("Total messages sent by OSS: %d\n\n", msgsnt);
- 	fprintf(logfile, "Total processes launched: %d\n", total);
-	fprintf(logfile, "Total messages sent by OSS: %d\n\n", msgsnt);
+ 	logPrintf("Total processes launched: %d\n", total);
+	logPrintf("Total messages sent by OSS: %d\n\n", msgsnt);
 	
-	printf("Total insertions in Queue 0: %d\n", q0Count);
-	printf("Total insertions in Queue 1: %d\n", q1Count);
-	printf("Total insertions in Queue 2: %d\n", q2Count);
+	for (int l = 0; l < readyLevels; l++)
+		printf("Total insertions in Queue %d: %d\n", l, queueCount[l]);
 	printf("Total insertions in Blocked Queue: %d\n\n", blockedCount);
 	
-	fprintf(logfile, "Total insertions in Queue 0: %d\n", q0Count);
-	fprintf(logfile, "Total insertions in Queue 1: %d\n", q1Count);
-	fprintf(logfile, "Total insertions in Queue 2: %d\n", q2Count);
-	fprintf(logfile, "Total insertions in Blocked Queue: %d\n\n", blockedCount);
+	for (int l = 0; l < readyLevels; l++)
+		logPrintf("Total insertions in Queue %d: %d\n", l, queueCount[l]);
+	logPrintf("Total insertions in Blocked Queue: %d\n\n", blockedCount);
 
 	// Calculate the final simulated time
-	currTimeNs = ((long long)shm_ptr[0] * 1000000000) + shm_ptr[1];
+	long long currTimeNs = clockNow(sysClock);
 
 	// Varialbes to find overall statistics
 	long long avgTurnaroundNs = 0;
@@ -667,8 +2708,9 @@ int main(int argc, char* argv[])
 	}
 
 	// If current time is greater than 0, calculate CPU utilization by dividing total service time (*100) by final time in ns
+	// With -M, every CPU could have been busy all that time
 	if (currTimeNs > 0)
-		cpuUtil = (totalServiceTimeNs * 100) / currTimeNs;
+		cpuUtil = (totalServiceTimeNs * 100) / (currTimeNs * (cpuModel ? cpus : 1));
 
 	// Print final statistics
 	printf("----Final Statistics----\n");
@@ -679,17 +2721,108 @@ int main(int argc, char* argv[])
 	printf("Average wait time: %lld ns\n", avgWaitNs);
 	printf("CPU utilization: %lld\n", cpuUtil);
 	printf("Total CPU idle time: %lld ns\n", totalIdleTimeNs);
+	// Each simulated CPU's share, if -M was given
+	if (cpuModel)
+	{
+		printf("CPU placement: new %s, unblocked %s, %s\n", placeNames[placeNew], placeNames[placeWake], cpuSteal ? "stealing" : "no stealing");
+		for (int c = 0; c < cpus; c++)
+			printf("CPU %d: %lld runs, %lld taken from other CPUs, busy %lld ns, idle %lld ns, utilization %lld\n", c, simCpus[c].dispatches,
+					simCpus[c].steals, simCpus[c].busyNs, simCpus[c].idleNs, currTimeNs > 0 ? simCpus[c].busyNs * 100 / currTimeNs : 0);
+	}
+	// Percentiles of each simulated time, for all queues and for each queue
+	char* latencyText = new char[latencyTextMax()];
+	int latencyLen = formatLatency(latencyText, latencyTextMax());
+	fwrite(latencyText, 1, latencyLen, stdout);
+	// Quanta the tuner settled on, if -A was given
+	char* tunerText = NULL;
+	int tunerLen = 0;
+	if (adaptPct > 0)
+	{
+		tunerText = new char[160 + numLevels * 96];
+		tunerLen = formatTuner(tunerText, 160 + numLevels * 96);
+		fwrite(tunerText, 1, tunerLen, stdout);
+	}
+	printf("Dispatch transport: %s, %lld round trips in %lld ns real time (%.0f dispatches/s)\n",
+			transportName(), dispatchCount, dispatchWallNs,
+			dispatchWallNs > 0 ? dispatchCount * 1e9 / dispatchWallNs : 0.0);
+	printf("Job launch: %s, average %lld ns real time per job (launch plus first round trip)\n",
+			launchName(), launchedJobs > 0 ? totalLaunchNs / launchedJobs : 0);
+	if (grantMax > 1)
+		printf("Quantum grants: %lld messages for %d quanta (up to %d per grant), %lld quanta taken from earlier grants\n",
+				grantsSent, msgsnt, grantMax, grantQuanta);
+	if (showLoad)
+	{
+		printf("Worker load: %s, 1/%d of simulated time used (%lld units per simulated s)\n", loadNames[loadKind], loadDiv, loadUnitsPerSec);
+		printf("Context switches: oss %ld voluntary, %ld involuntary; workers %ld voluntary, %ld involuntary\n",
+				ossUsage.ru_nvcsw, ossUsage.ru_nivcsw, workerUsage.ru_nvcsw, workerUsage.ru_nivcsw);
+	}
+	printf("Total real time: %lld ns\n", realTimeNs() - startRealNs);
+	if (logDropped() > 0)
+		printf("Log lines dropped: %lld\n", logDropped());
+	if (crashedWorkers > 0)
+		printf("Workers that exited without replying: %lld\n", crashedWorkers);
+	if (ckptPath != NULL)
+		printf("Checkpoints written: %lld to %s\n", checkpoints, ckptPath);
+
+	// One line of key=value pairs for bench.sh and other scripts to parse
+	if (benchMode)
+	{
+		long long wallNs = realTimeNs() - startRealNs;
+		printf("BENCH table=%d cpus=%d mix=%d,%d transport=%s launch=%s grant=%d load=%s jobs=%lld wall_ns=%lld dispatches=%lld grants=%lld grant_quanta=%lld dispatches_per_s=%.0f"
+				" rtt_p50_ns=%lld rtt_p99_ns=%lld rtt_p999_ns=%lld rtt_max_ns=%lld"
+				" launch_p50_ns=%lld launch_p99_ns=%lld launch_p999_ns=%lld"
+				" scan_p50_ns=%lld scan_p99_ns=%lld scan_p999_ns=%lld ticks=%lld"
+				" oss_csw=%ld oss_icsw=%ld worker_csw=%ld worker_icsw=%ld\n",
+				tableSize, cpus, termPct, blockPct, transportName(), launchName(), grantMax, loadNames[loadKind],
+				launchedJobs, wallNs, msgsnt - grantQuanta, grantsSent, grantQuanta, wallNs > 0 ? (msgsnt - grantQuanta) * 1e9 / wallNs : 0.0,
+				histPercentile(&dispatchHist, 50), histPercentile(&dispatchHist, 99), histPercentile(&dispatchHist, 99.9), dispatchHist.max,
+				histPercentile(&launchHist, 50), histPercentile(&launchHist, 99), histPercentile(&launchHist, 99.9),
+				histPercentile(&tickHist, 50), histPercentile(&tickHist, 99), histPercentile(&tickHist, 99.9), tickHist.total,
+				ossUsage.ru_nvcsw, ossUsage.ru_nivcsw, workerUsage.ru_nvcsw, workerUsage.ru_nivcsw);
+	}
+
+	logPrintf("----Final Statistics----\n");
+	logPrintf("Total simulated time: %lld ns\n", currTimeNs);
+	logPrintf("Terminated processes: %lld\n", terminatedProcesses);
+	logPrintf("Average turnaround time: %lld ns\n", avgTurnaroundNs);
+	logPrintf("CPU utilization: %lld\n", cpuUtil);
+	logPrintf("Total CPU idle time: %lld ns\n", totalIdleTimeNs);
+	if (cpuModel)
+	{
+		logPrintf("CPU placement: new %s, unblocked %s, %s\n", placeNames[placeNew], placeNames[placeWake], cpuSteal ? "stealing" : "no stealing");
+		for (int c = 0; c < cpus; c++)
+			logPrintf("CPU %d: %lld runs, %lld taken from other CPUs, busy %lld ns, idle %lld ns, utilization %lld\n", c, simCpus[c].dispatches,
+					simCpus[c].steals, simCpus[c].busyNs, simCpus[c].idleNs, currTimeNs > 0 ? simCpus[c].busyNs * 100 / currTimeNs : 0);
+	}
+	logWrite(latencyText, latencyLen);
+	delete[] latencyText;
+	if (tunerText != NULL)
+	{
+		logWrite(tunerText, tunerLen);
+		delete[] tunerText;
+	}
+	logPrintf("Dispatch transport: %s, %lld round trips in %lld ns real time (%.0f dispatches/s)\n",
+			transportName(), dispatchCount, dispatchWallNs,
+			dispatchWallNs > 0 ? dispatchCount * 1e9 / dispatchWallNs : 0.0);
+	logPrintf("Job launch: %s, average %lld ns real time per job (launch plus first round trip)\n",
+			launchName(), launchedJobs > 0 ? totalLaunchNs / launchedJobs : 0);
+	if (grantMax > 1)
+		logPrintf("Quantum grants: %lld messages for %d quanta (up to %d per grant), %lld quanta taken from earlier grants\n",
+				grantsSent, msgsnt, grantMax, grantQuanta);
+	if (showLoad)
+	{
+		logPrintf("Worker load: %s, 1/%d of simulated time used (%lld units per simulated s)\n", loadNames[loadKind], loadDiv, loadUnitsPerSec);
+		logPrintf("Context switches: oss %ld voluntary, %ld involuntary; workers %ld voluntary, %ld involuntary\n",
+				ossUsage.ru_nvcsw, ossUsage.ru_nivcsw, workerUsage.ru_nvcsw, workerUsage.ru_nivcsw);
+	}
+	logPrintf("Total real time: %lld ns\n", realTimeNs() - startRealNs);
 
-	fprintf(logfile, "----Final Statistics----\n");
-	fprintf(logfile, "Total simulated time: %lld ns\n", currTimeNs);
-	fprintf(logfile, "Terminated processes: %lld\n", terminatedProcesses);
-	fprintf(logfile, "Average turnaround time: %lld ns\n", avgTurnaroundNs);
-	fprintf(logfile, "CPU utilization: %lld\n", cpuUtil);
-	fprintf(logfile, "Total CPU idle time: %lld ns\n", totalIdleTimeNs);
 
+	// Publish final statistics if -S was given and remove them, while the clock is still attached
+	removeStats();
 
 	// Detach from shared memory and remove it
-	if(shmdt(shm_ptr) == -1)
+	if(shmdt(sysClock) == -1)
 	{
 		perror("shmdt failed");
 		exit(1);
@@ -700,12 +2833,17 @@ int main(int argc, char* argv[])
 		exit(1);
 	}
 
-	// Remove the message queue
-	if (msgctl(msqid, IPC_RMID, NULL) == -1)
-	{
-		perror("msgctl failed");
+	// Remove the message queues
+	if (removeQueues() == -1)
 		exit(1);
-	}
+
+	// Remove mailboxes if mailbox transport was used
+	removeMailboxes();
+
+	// Write out whatever is still waiting in the log buffer and trace
+	logClose();
+	traceClose();
+	ckptClose();
 
 	return 0;
 
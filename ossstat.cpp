@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/shm.h>
+#include <sys/types.h>
+#include "ossstats.h"
+
+// Copy of every value in the statistics segment at one moment
+typedef struct
+{
+	long long realNs; // Real time the copy was taken
+	long long phaseNs[STATS_PHASES];
+	long long phaseCount[STATS_PHASES];
+	long long spawned;
+	long long terminated;
+	long long dispatches;
+	long long blocked;
+	long long running;
+	long long simNs;
+	long long logLines;
+	long long logBytes;
+	long long logNs;
+} statsSample;
+
+ossStats* stats; // Statistics segment published by oss
+
+// Function to return current real (monotonic) time in ns
+long long realTimeNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Function to attach to the statistics segment of a running oss, by the ID oss printed when it started
+void statsMem(int stats_id)
+{
+	// Attach read-only, ossstat never writes to the segment
+	stats = (ossStats*)shmat(stats_id, 0, SHM_RDONLY);
+	if (stats == (ossStats*)-1)
+	{
+		fprintf(stderr, "No statistics found in segment %d, give the ID printed by oss -S.\n", stats_id);
+		exit(1);
+	}
+	if (stats->magic != STATS_MAGIC)
+	{
+		fprintf(stderr, "Statistics segment was not written by a compatible oss.\n");
+		exit(1);
+	}
+}
+
+// Function to copy the current values out of the segment
+void takeSample(statsSample* sample)
+{
+	sample->realNs = realTimeNs();
+	for (int p = 0; p < STATS_PHASES; p++)
+	{
+		sample->phaseNs[p] = stats->phaseNs[p].load(std::memory_order_relaxed);
+		sample->phaseCount[p] = stats->phaseCount[p].load(std::memory_order_relaxed);
+	}
+	sample->spawned = stats->spawned.load(std::memory_order_relaxed);
+	sample->terminated = stats->terminated.load(std::memory_order_relaxed);
+	sample->dispatches = stats->dispatches.load(std::memory_order_relaxed);
+	sample->blocked = stats->blocked.load(std::memory_order_relaxed);
+	sample->running = stats->running.load(std::memory_order_relaxed);
+	sample->simNs = stats->simNs.load(std::memory_order_relaxed);
+	sample->logLines = stats->logLines.load(std::memory_order_relaxed);
+	sample->logBytes = stats->logBytes.load(std::memory_order_relaxed);
+	sample->logNs = stats->logNs.load(std::memory_order_relaxed);
+}
+
+// Function to print the rates between two samples, and where oss spent its time
+void printRates(const statsSample* prev, const statsSample* curr)
+{
+	double secs = (curr->realNs - prev->realNs) / 1e9;
+	if (secs <= 0)
+		return;
+
+	printf("%8.2f %6lld %9.0f %9.0f %10.0f %9.0f %9.0f %9.1f |",
+			curr->simNs / 1e9, curr->running,
+			(curr->phaseCount[PHASE_SCAN] - prev->phaseCount[PHASE_SCAN]) / secs,
+			(curr->spawned - prev->spawned) / secs,
+			(curr->dispatches - prev->dispatches) / secs,
+			(curr->terminated - prev->terminated) / secs,
+			(curr->blocked - prev->blocked) / secs,
+			(curr->logBytes - prev->logBytes) / 1024.0 / secs);
+
+	// Share of real time spent in each phase, and the average time of one pass through it
+	for (int p = 0; p < STATS_PHASES; p++)
+	{
+		long long ns = curr->phaseNs[p] - prev->phaseNs[p];
+		long long count = curr->phaseCount[p] - prev->phaseCount[p];
+		printf(" %5.1f%% %6lld", ns / (secs * 1e7), count > 0 ? ns / count : 0);
+	}
+	// Share of real time spent adding to the log, which is part of the phases it happens in
+	printf(" | %5.1f%%\n", (curr->logNs - prev->logNs) / (secs * 1e7));
+	fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+	int intervalMs = 1000; // Time between samples
+	int count = 0; // Number of samples to print, 0 to keep going until oss finishes
+	int statsId = -1; // Statistics segment to read
+	int opt;
+	while ((opt = getopt(argc, argv, "hs:i:c:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'h':
+				printf("Usage: %s [-h] -s id [-i ms] [-c count]\n", argv[0]);
+				printf("  Attaches to the statistics published by oss -S and prints live rates\n");
+				printf("  -s id     Statistics segment ID printed by oss -S\n");
+				printf("  -i ms     Time between samples (default: 1000)\n");
+				printf("  -c count  Stop after count samples (default: until oss finishes)\n");
+				exit(0);
+			case 's':
+				statsId = atoi(optarg);
+				break;
+			case 'i':
+				intervalMs = atoi(optarg);
+				break;
+			case 'c':
+				count = atoi(optarg);
+				break;
+			default:
+				break;
+		}
+	}
+	if (intervalMs < 1 || count < 0)
+	{
+		fprintf(stderr, "-i must be at least 1 and -c can not be negative\n");
+		exit(1);
+	}
+	if (statsId < 0)
+	{
+		fprintf(stderr, "-s must give the statistics segment ID printed by oss -S\n");
+		exit(1);
+	}
+
+	statsMem(statsId);
+	pid_t ossPid = stats->ossPid.load();
+
+	// Header: rates per second, then for each phase its share of real time and average ns per pass
+	printf("%8s %6s %9s %9s %10s %9s %9s %9s |", "sim_s", "run", "loops/s", "spawn/s", "dispatch/s", "term/s", "block/s", "logKB/s");
+	for (int p = 0; p < STATS_PHASES; p++)
+		printf(" %7s %6s", statsPhaseNames[p], "ns");
+	printf(" | %6s\n", "log");
+
+	statsSample prev, curr;
+	takeSample(&prev);
+	struct timespec interval = {intervalMs / 1000, (intervalMs % 1000) * 1000000L};
+	for (int i = 0; count == 0 || i < count; i++)
+	{
+		nanosleep(&interval, NULL);
+		takeSample(&curr);
+		printRates(&prev, &curr);
+		prev = curr;
+
+		// Stop once oss has finished or is gone
+		if (stats->done.load() || (kill(ossPid, 0) == -1 && errno == ESRCH))
+			break;
+	}
+
+	shmdt(stats);
+	return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef OSSSTATS_H
+#define OSSSTATS_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Live statistics segment
+// With -S, oss times each phase of its main loop and keeps running counters in this shared memory segment,
+// which ossstat attaches to read-only and samples while the simulation runs. oss is the only writer and each
+// value is a single 64 bit word, so readers never see a torn value and oss never waits on a reader
+
+// Value checked by ossstat to make sure it attached to a segment written by a compatible oss
+#define STATS_MAGIC 0x4f535331
+
+// Phases of the main loop. Time between two phase ends is billed to the later one
+#define PHASE_PRINT 0 // Status print
+#define PHASE_SCAN 1 // Clock tick and blocked queue scan
+#define PHASE_SPAWN 2 // Launching a new job
+#define PHASE_DISPATCH 3 // Picking processes and sending them a quantum
+#define PHASE_RECEIVE 4 // Waiting for a worker's reply
+#define PHASE_ACCOUNT 5 // Handling the reply: clock, statistics, requeue, block or terminate
+#define PHASE_IDLE 6 // Idle CPU, including discrete-event skips
+#define STATS_PHASES 7
+
+// Names of the phases, in order, for printing
+static const char* const statsPhaseNames[STATS_PHASES] = {"print", "scan", "spawn", "dispatch", "receive", "account", "idle"};
+
+typedef struct
+{
+	uint32_t magic; // STATS_MAGIC once the segment is set up
+	std::atomic<int> ossPid; // PID of oss writing the segment
+	std::atomic<int> done; // Set once the simulation has finished
+	std::atomic<long long> phaseNs[STATS_PHASES]; // Real time spent in each phase in ns
+	std::atomic<long long> phaseCount[STATS_PHASES]; // Times each phase ran, scan runs once per main loop iteration
+	// Counters below are copied from oss's own every 10 ms of real time and when it finishes
+	std::atomic<long long> spawned; // Jobs launched
+	std::atomic<long long> terminated; // Jobs finished
+	std::atomic<long long> dispatches; // Quanta sent
+	std::atomic<long long> blocked; // Times a process blocked
+	std::atomic<long long> running; // Jobs currently in the process table
+	std::atomic<long long> simNs; // Simulated time in ns
+	std::atomic<long long> logLines; // Lines added to the log
+	std::atomic<long long> logBytes; // Bytes added to the log
+	std::atomic<long long> logNs; // Real time oss spent adding to the log in ns
+} ossStats;
+
+// Function to add to a statistic. Only oss writes, so a relaxed load and store is enough and no locked
+// instruction is needed
+static inline void statAdd(std::atomic<long long>* stat, long long delta)
+{
+	stat->store(stat->load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+// Function to set a statistic
+static inline void statSet(std::atomic<long long>* stat, long long value)
+{
+	stat->store(value, std::memory_order_relaxed);
+}
+
+#endif
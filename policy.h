@@ -0,0 +1,647 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "checkpoint.h"
+#include "histogram.h"
+
+// Most ready queues a policy can have, one bit each in a 64 bit mask
+#define MAX_LEVELS 64
+
+// Scheduling policies
+// A policy decides which ready process runs next, what a run costs it, and where it goes once it is ready
+// again. oss's main loop is a template over the policy, so every call below is resolved at compile time and
+// inlined, and the default MLFQ path pays nothing for being swappable. Every policy provides:
+//   void init(int tableSize)                        Make room for every process table entry
+//   int admit(int indx, long long nowNs)            New process is ready. Returns the queue it went in
+//   int wake(int indx, long long nowNs)             Blocked process is ready again. Returns the queue it went in
+//   int pick(long long nowNs, int* quantum, int* level)
+//                                                   Take the next process to run and set its quantum in ns and
+//                                                   the queue it came from. Returns its index, or -1 if none is ready
+//   void charge(int indx, int usedNs, int quantum)  Bill a finished run to the process, whatever its outcome
+//   int requeue(int indx, long long nowNs)          Process used its whole quantum and is ready again. Returns
+//                                                   the queue it went in
+//   int fixedQuantum(int indx) const                Process just picked gets this same quantum every time it is
+//                                                   requeued and picked again, until it blocks or terminates
+//   int levels() const                              Number of ready queues, shown in status prints
+//   void visit(int level, F f) const                Call f(indx) for every ready process in a queue
+//   void transfer(stateIO* io)                      Walk every value that changes as the policy runs, to save it
+//                                                   in a checkpoint or load it back
+
+// Adaptive quanta
+// Instead of keeping each MLFQ queue's quantum fixed, a tuner can retune it as the run goes so that targetPct
+// percent of the runs dispatched from the queue end, by blocking or terminating, before their quantum is used up.
+// The time every run used goes into its queue's usage histograms. After ADAPT_WINDOW runs from a queue, its
+// quantum moves toward the targetPct-th percentile of those runs, since that is the quantum they would have needed
+// Tuning is bounded so it can not oscillate or run away. Nothing changes while the share ending within quantum
+// is within ADAPT_DEADBAND points of the target, about three times the noise in a window's share, one retune
+// grows a quantum by at most 5/4 or shrinks it by at most 4/5, and a quantum stays between a quarter and four
+// times the one it was configured with
+#define ADAPT_WINDOW 256
+#define ADAPT_DEADBAND 7
+// Largest quantum a tuner gives in ns, the same as the largest -L takes
+#define ADAPT_MAX_QUANTUM 2000000000LL
+
+typedef struct
+{
+	int targetPct; // Percent of runs that should end within their quantum
+	int numLevels; // Number of queues
+	int baseQuanta[MAX_LEVELS]; // Quantum each queue was configured with in ns
+	int quanta[MAX_LEVELS]; // Quantum each queue has now in ns
+	latencyHist* usage; // Time used by every run from each queue in ns
+	latencyHist* window; // Time used by each queue's runs since its last retune in ns
+	long long within[MAX_LEVELS]; // Runs from each queue that ended within their quantum
+	long long windowWithin[MAX_LEVELS]; // Same, since the queue's last retune
+	int retunes[MAX_LEVELS]; // Times each queue's quantum has been changed
+} quantumTuner;
+
+// Function to set up a tuner for queues configured with the given quanta
+static inline void tunerInit(quantumTuner* t, int targetPct, const int* quanta, int levels)
+{
+	t->targetPct = targetPct;
+	t->numLevels = levels;
+	t->usage = new latencyHist[levels];
+	t->window = new latencyHist[levels];
+	for (int l = 0; l < levels; l++)
+	{
+		t->baseQuanta[l] = quanta[l];
+		t->quanta[l] = quanta[l];
+		histInit(&t->usage[l]);
+		histInit(&t->window[l]);
+		t->within[l] = 0;
+		t->windowWithin[l] = 0;
+		t->retunes[l] = 0;
+	}
+}
+
+// Function to retune queue l's quantum from the window of runs just finished, and start the next window
+static inline void tunerRetune(quantumTuner* t, int l)
+{
+	// Runs that used their whole quantum were cut short, so a window short of the target only says the quantum
+	// should grow. One over the target shows how far it can shrink
+	long long q = t->quanta[l];
+	long long pct = t->windowWithin[l] * 100 / t->window[l].total;
+	long long want = q;
+	if (pct < t->targetPct - ADAPT_DEADBAND)
+		want = q * 5 / 4;
+	else if (pct > t->targetPct + ADAPT_DEADBAND)
+		want = std::max(std::min(histPercentile(&t->window[l], t->targetPct), q), q * 4 / 5);
+	want = std::max(want, (long long)t->baseQuanta[l] / 4);
+	want = std::min(want, std::min(4LL * t->baseQuanta[l], ADAPT_MAX_QUANTUM));
+	if (want != q)
+	{
+		t->quanta[l] = (int)want;
+		t->retunes[l]++;
+	}
+	histInit(&t->window[l]);
+	t->windowWithin[l] = 0;
+}
+
+// Function to record a run from queue l that used usedNs. It counts as ending within its quantum unless
+// tunerFull is called for it. Returns the queue's quantum from now on
+static inline int tunerRecord(quantumTuner* t, int l, int usedNs)
+{
+	// The window is complete once its last run is known to have ended one way or the other
+	if (t->window[l].total == ADAPT_WINDOW)
+		tunerRetune(t, l);
+	histRecord(&t->usage[l], usedNs);
+	histRecord(&t->window[l], usedNs);
+	t->within[l]++;
+	t->windowWithin[l]++;
+	return t->quanta[l];
+}
+
+// Function to mark the run last recorded for queue l as having used its whole quantum
+static inline void tunerFull(quantumTuner* t, int l)
+{
+	t->within[l]--;
+	t->windowWithin[l]--;
+}
+
+// Function to walk a tuner's state for a checkpoint
+static inline void tunerTransfer(quantumTuner* t, stateIO* io)
+{
+	stateArray(io, t->quanta, t->numLevels);
+	stateArray(io, t->usage, t->numLevels);
+	stateArray(io, t->window, t->numLevels);
+	stateArray(io, t->within, t->numLevels);
+	stateArray(io, t->windowWithin, t->numLevels);
+	stateArray(io, t->retunes, t->numLevels);
+}
+
+// Multi-level feedback queue with any number of queues, each with its own quantum. A process starts in queue 0
+// and drops one queue each time it uses its whole quantum. Blocked processes come back to queue 0
+// If boostNs is set, every process is moved back to queue 0 that often, so long-running ones are not starved
+// A bit per queue marks the nonempty ones, so the highest priority ready queue is found with one find-first-set
+// however many queues there are
+// Queues are linked lists threaded through an array indexed by table entry, so a process is in at most one queue,
+// adding and taking never allocate, and a boost splices each lower queue onto queue 0 in one step
+// Given a tuner, each queue's quantum is retuned from the runs charged to it, see quantumTuner above
+struct mlfqPolicy
+{
+	int numLevels; // Number of queues
+	int quanta[MAX_LEVELS]; // Time quantum of each queue in ns
+	int head[MAX_LEVELS]; // First process in each queue, -1 if empty
+	int tail[MAX_LEVELS]; // Last process in each queue
+	int* next; // Process after each one in its queue, -1 at the end
+	uint64_t readyMask; // Bit l set means queue l is nonempty
+	int* slotLevel; // Queue each process was last taken from
+	long long boostNs; // Time between priority boosts in ns, 0 for none
+	long long nextBoostNs; // Time of next priority boost
+	int boostEpoch; // Number of boosts so far
+	int* slotEpoch; // Boost epoch each process was last picked in, to send it to queue 0 if a boost happened since
+	int size; // Number of table entries
+	quantumTuner* tuner; // Retunes the quanta, NULL to keep them fixed
+
+	mlfqPolicy(const int* levelQuanta, int levels, long long boost, quantumTuner* tune) : numLevels(levels), next(NULL), readyMask(0),
+			slotLevel(NULL), boostNs(boost), nextBoostNs(boost), boostEpoch(0), slotEpoch(NULL), size(0), tuner(tune)
+	{
+		for (int l = 0; l < numLevels; l++)
+		{
+			quanta[l] = levelQuanta[l];
+			head[l] = -1;
+			tail[l] = -1;
+		}
+	}
+
+	void init(int tableSize)
+	{
+		size = tableSize;
+		next = new int[tableSize];
+		slotLevel = new int[tableSize];
+		slotEpoch = new int[tableSize];
+	}
+
+	// Function to add a process to the back of queue l
+	int push(int indx, int l)
+	{
+		next[indx] = -1;
+		if (head[l] == -1)
+			head[l] = indx;
+		else
+			next[tail[l]] = indx;
+		tail[l] = indx;
+		readyMask |= 1ULL << l;
+		return l;
+	}
+
+	int admit(int indx, long long nowNs)
+	{
+		return push(indx, 0);
+	}
+
+	int wake(int indx, long long nowNs)
+	{
+		return push(indx, 0);
+	}
+
+	// Function to move every ready process to queue 0, keeping them in priority order
+	void boost()
+	{
+		uint64_t lower = readyMask & ~1ULL;
+		while (lower != 0)
+		{
+			int l = __builtin_ctzll(lower);
+			lower &= lower - 1;
+			// Splice queue l onto the back of queue 0
+			if (head[0] == -1)
+				head[0] = head[l];
+			else
+				next[tail[0]] = head[l];
+			tail[0] = tail[l];
+			head[l] = -1;
+			tail[l] = -1;
+		}
+		if (readyMask != 0)
+			readyMask = 1;
+		boostEpoch++;
+	}
+
+	int pick(long long nowNs, int* quantum, int* level)
+	{
+		if (boostNs > 0 && nowNs >= nextBoostNs)
+		{
+			boost();
+			nextBoostNs = nowNs + boostNs;
+		}
+
+		// Take from the first nonempty queue
+		if (readyMask == 0)
+			return -1;
+		int l = __builtin_ctzll(readyMask);
+		int indx = head[l];
+		head[l] = next[indx];
+		if (head[l] == -1)
+		{
+			tail[l] = -1;
+			readyMask &= ~(1ULL << l);
+		}
+		slotLevel[indx] = l;
+		slotEpoch[indx] = boostEpoch;
+		*quantum = quanta[l];
+		*level = l;
+		return indx;
+	}
+
+	void charge(int indx, int usedNs, int quantum)
+	{
+		if (tuner != NULL)
+			quanta[slotLevel[indx]] = tunerRecord(tuner, slotLevel[indx], usedNs);
+	}
+
+	int requeue(int indx, long long nowNs)
+	{
+		if (tuner != NULL)
+			tunerFull(tuner, slotLevel[indx]);
+		// Drop one queue, unless a boost happened while process was running
+		int l = slotEpoch[indx] == boostEpoch ? std::min(slotLevel[indx] + 1, numLevels - 1) : 0;
+		return push(indx, l);
+	}
+
+	int fixedQuantum(int indx) const
+	{
+		// Only the last queue keeps a process that uses its whole quantum, and a boost would move it up
+		// A tuner can change the quantum after any run
+		return slotLevel[indx] == numLevels - 1 && boostNs == 0 && tuner == NULL;
+	}
+
+	int levels() const
+	{
+		return numLevels;
+	}
+
+	template <typename F>
+	void visit(int level, F f) const
+	{
+		for (int indx = head[level]; indx != -1; indx = next[indx])
+			f(indx);
+	}
+
+	void transfer(stateIO* io)
+	{
+		stateArray(io, head, numLevels);
+		stateArray(io, tail, numLevels);
+		stateArray(io, next, size);
+		stateArray(io, &readyMask, 1);
+		stateArray(io, slotLevel, size);
+		stateArray(io, &nextBoostNs, 1);
+		stateArray(io, &boostEpoch, 1);
+		stateArray(io, slotEpoch, size);
+		if (tuner != NULL)
+		{
+			tunerTransfer(tuner, io);
+			memcpy(quanta, tuner->quanta, numLevels * sizeof(int));
+		}
+	}
+};
+
+// Function to get the next number from a policy's own xorshift generator
+// Policies that draw at random keep their own generator, so they do not change the workload drawn with rand()
+static inline uint64_t policyRand(uint64_t* state)
+{
+	uint64_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+// Lottery scheduling. Each ready process holds tickets and a random draw picks the winner, so a process gets CPU
+// in proportion to its tickets. A process that gave up the CPU after using a fraction f of its quantum gets 1/f
+// times the base tickets (compensation tickets) until it next runs, so I/O-bound processes still get their share
+// Tickets are kept in a Fenwick tree over table entries, so a draw costs O(log n)
+struct lotteryPolicy
+{
+	static const int baseTickets = 100;
+	int quantum; // Time quantum of every run in ns
+	int size; // Number of table entries
+	int top; // Largest power of two no bigger than size, where a draw starts its descent
+	long long* tree; // Fenwick tree of ready tickets, 1-based
+	int* tickets; // Tickets each ready process holds, 0 if not ready
+	int* nextTickets; // Tickets process will hold when it is next ready
+	uint64_t rng;
+
+	lotteryPolicy(int q) : quantum(q), size(0), top(0), tree(NULL), tickets(NULL), nextTickets(NULL), rng(0x9e3779b97f4a7c15ULL)
+	{
+	}
+
+	void init(int tableSize)
+	{
+		size = tableSize;
+		top = 1;
+		while (top * 2 <= size)
+			top *= 2;
+		tree = new long long[size + 1]();
+		tickets = new int[size]();
+		nextTickets = new int[size]();
+	}
+
+	// Function to add delta tickets to a table entry
+	void add(int indx, long long delta)
+	{
+		for (int i = indx + 1; i <= size; i += i & -i)
+			tree[i] += delta;
+	}
+
+	// Function to make a process ready with the tickets it has earned
+	int ready(int indx)
+	{
+		tickets[indx] = nextTickets[indx];
+		add(indx, tickets[indx]);
+		return 0;
+	}
+
+	int admit(int indx, long long nowNs)
+	{
+		nextTickets[indx] = baseTickets;
+		return ready(indx);
+	}
+
+	int wake(int indx, long long nowNs)
+	{
+		return ready(indx);
+	}
+
+	int pick(long long nowNs, int* q, int* level)
+	{
+		// Total tickets held is the sum of the whole tree
+		long long totalTickets = 0;
+		for (int i = size; i > 0; i -= i & -i)
+			totalTickets += tree[i];
+		if (totalTickets == 0)
+			return -1;
+
+		// Descend the tree to the entry holding the winning ticket
+		long long winner = policyRand(&rng) % totalTickets;
+		int pos = 0;
+		for (int step = top; step > 0; step /= 2)
+		{
+			if (pos + step <= size && tree[pos + step] <= winner)
+			{
+				pos += step;
+				winner -= tree[pos];
+			}
+		}
+		int indx = pos;
+		add(indx, -tickets[indx]);
+		tickets[indx] = 0;
+		*q = quantum;
+		*level = 0;
+		return indx;
+	}
+
+	void charge(int indx, int usedNs, int q)
+	{
+		// Compensate a process that used only part of its quantum, up to 10 times the base tickets
+		int used = std::max(usedNs, q / 10);
+		nextTickets[indx] = used > 0 ? (int)((long long)baseTickets * q / used) : baseTickets;
+	}
+
+	int requeue(int indx, long long nowNs)
+	{
+		return ready(indx);
+	}
+
+	int fixedQuantum(int indx) const
+	{
+		return 1;
+	}
+
+	int levels() const
+	{
+		return 1;
+	}
+
+	template <typename F>
+	void visit(int level, F f) const
+	{
+		for (int i = 0; i < size; i++)
+			if (tickets[i] > 0)
+				f(i);
+	}
+
+	void transfer(stateIO* io)
+	{
+		stateArray(io, tree, size + 1);
+		stateArray(io, tickets, size);
+		stateArray(io, nextTickets, size);
+		stateArray(io, &rng, 1);
+	}
+};
+
+// Entry in a policy's ready heap, smallest key first and ties broken by the order processes became ready
+typedef struct
+{
+	long long key;
+	long long seq;
+	int indx;
+} readyEntry;
+
+// Function to order a ready heap so the smallest key is at the top
+static inline bool readyAfter(const readyEntry& a, const readyEntry& b)
+{
+	if (a.key != b.key)
+		return a.key > b.key;
+	return a.seq > b.seq;
+}
+
+// Stride scheduling. Every process advances a pass value by its stride, scaled by how much of its quantum it
+// used, and the ready process with the lowest pass runs next. With equal tickets this shares the CPU evenly by
+// time used, deterministically. New and woken processes start at the current global pass, so they can not
+// claim CPU for time they were not ready
+struct stridePolicy
+{
+	static const long long stride = 1 << 20; // Stride of a process holding the base tickets
+	int quantum; // Time quantum of every run in ns
+	long long* pass; // Pass value of each process
+	long long globalPass; // Pass of the last process picked
+	long long seq; // Order in which processes became ready
+	std::vector<readyEntry> heap; // Ready processes, lowest pass first
+	int size; // Number of table entries
+
+	stridePolicy(int q) : quantum(q), pass(NULL), globalPass(0), seq(0), size(0)
+	{
+	}
+
+	void init(int tableSize)
+	{
+		size = tableSize;
+		pass = new long long[tableSize]();
+		// Reserve room for every table entry so becoming ready never allocates
+		heap.reserve(tableSize);
+	}
+
+	int push(int indx)
+	{
+		readyEntry entry = {pass[indx], seq++, indx};
+		heap.push_back(entry);
+		std::push_heap(heap.begin(), heap.end(), readyAfter);
+		return 0;
+	}
+
+	int admit(int indx, long long nowNs)
+	{
+		pass[indx] = globalPass;
+		return push(indx);
+	}
+
+	int wake(int indx, long long nowNs)
+	{
+		pass[indx] = std::max(pass[indx], globalPass);
+		return push(indx);
+	}
+
+	int pick(long long nowNs, int* q, int* level)
+	{
+		if (heap.empty())
+			return -1;
+		std::pop_heap(heap.begin(), heap.end(), readyAfter);
+		int indx = heap.back().indx;
+		heap.pop_back();
+		globalPass = pass[indx];
+		*q = quantum;
+		*level = 0;
+		return indx;
+	}
+
+	void charge(int indx, int usedNs, int q)
+	{
+		if (q > 0)
+			pass[indx] += stride * usedNs / q;
+	}
+
+	int requeue(int indx, long long nowNs)
+	{
+		return push(indx);
+	}
+
+	int fixedQuantum(int indx) const
+	{
+		return 1;
+	}
+
+	int levels() const
+	{
+		return 1;
+	}
+
+	template <typename F>
+	void visit(int level, F f) const
+	{
+		for (size_t i = 0; i < heap.size(); i++)
+			f(heap[i].indx);
+	}
+
+	void transfer(stateIO* io)
+	{
+		stateArray(io, pass, size);
+		stateArray(io, &globalPass, 1);
+		stateArray(io, &seq, 1);
+		stateVector(io, &heap, size);
+	}
+};
+
+// Completely fair scheduling in the style of Linux CFS. Each process accrues virtual runtime as it runs and
+// the ready process with the least runs next, for a slice of the target latency shared among the ready
+// processes but never less than the minimum granularity. New processes start at the smallest virtual runtime
+// seen, and woken ones at most half a target latency behind it, so sleeping earns a little but not unbounded
+// credit. The ready processes are kept in a min-heap on virtual runtime rather than a red-black tree, since only
+// the smallest is ever taken
+struct cfsPolicy
+{
+	int latencyNs; // Target time for every ready process to run once
+	int minGranularityNs; // Smallest slice given
+	long long* vruntime; // Virtual runtime of each process in ns
+	long long minVruntime; // Smallest virtual runtime seen, never goes backwards
+	long long seq; // Order in which processes became ready
+	std::vector<readyEntry> heap; // Ready processes, least virtual runtime first
+	int size; // Number of table entries
+
+	cfsPolicy(int latency, int minGranularity) : latencyNs(latency), minGranularityNs(minGranularity), vruntime(NULL), minVruntime(0), seq(0), size(0)
+	{
+	}
+
+	void init(int tableSize)
+	{
+		size = tableSize;
+		vruntime = new long long[tableSize]();
+		// Reserve room for every table entry so becoming ready never allocates
+		heap.reserve(tableSize);
+	}
+
+	int push(int indx)
+	{
+		readyEntry entry = {vruntime[indx], seq++, indx};
+		heap.push_back(entry);
+		std::push_heap(heap.begin(), heap.end(), readyAfter);
+		return 0;
+	}
+
+	int admit(int indx, long long nowNs)
+	{
+		vruntime[indx] = minVruntime;
+		return push(indx);
+	}
+
+	int wake(int indx, long long nowNs)
+	{
+		vruntime[indx] = std::max(vruntime[indx], minVruntime - latencyNs / 2);
+		return push(indx);
+	}
+
+	int pick(long long nowNs, int* q, int* level)
+	{
+		if (heap.empty())
+			return -1;
+		// Slice is shared among every process that is ready, including the one being picked
+		int slice = std::max(latencyNs / (int)heap.size(), minGranularityNs);
+		std::pop_heap(heap.begin(), heap.end(), readyAfter);
+		int indx = heap.back().indx;
+		heap.pop_back();
+		minVruntime = std::max(minVruntime, vruntime[indx]);
+		*q = slice;
+		*level = 0;
+		return indx;
+	}
+
+	void charge(int indx, int usedNs, int q)
+	{
+		vruntime[indx] += usedNs;
+	}
+
+	int requeue(int indx, long long nowNs)
+	{
+		return push(indx);
+	}
+
+	int fixedQuantum(int indx) const
+	{
+		// Slice depends on how many processes are ready when it is picked
+		return 0;
+	}
+
+	int levels() const
+	{
+		return 1;
+	}
+
+	template <typename F>
+	void visit(int level, F f) const
+	{
+		for (size_t i = 0; i < heap.size(); i++)
+			f(heap[i].indx);
+	}
+
+	void transfer(stateIO* io)
+	{
+		stateArray(io, vruntime, size);
+		stateArray(io, &minVruntime, 1);
+		stateArray(io, &seq, 1);
+		stateVector(io, &heap, size);
+	}
+};
+
+#endif
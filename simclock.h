@@ -0,0 +1,38 @@
+#ifndef SIMCLOCK_H
+#define SIMCLOCK_H
+
+#include <atomic>
+
+// Layout of the shared memory system clock
+// A single 64 bit count of ns, so any process attached to the segment reads it in one load and never sees a
+// half-updated seconds/nanoseconds pair. Only oss advances it
+typedef struct
+{
+	std::atomic<long long> ns; // Simulated time since oss started in ns
+} simClock;
+
+// Function to read the clock in ns
+static inline long long clockNow(const simClock* clk)
+{
+	return clk->ns.load(std::memory_order_acquire);
+}
+
+// Function to advance the clock by ns. oss is the only writer, so a plain load and store is enough
+static inline void clockAdvance(simClock* clk, long long ns)
+{
+	clk->ns.store(clk->ns.load(std::memory_order_relaxed) + ns, std::memory_order_release);
+}
+
+// Function to get the whole seconds part of a time in ns
+static inline int clockSec(long long ns)
+{
+	return (int)(ns / 1000000000);
+}
+
+// Function to get the nanoseconds part of a time in ns
+static inline int clockNano(long long ns)
+{
+	return (int)(ns % 1000000000);
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SLOTMAP_H
+#define SLOTMAP_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Bitmap of occupied process table slots
+// A second level summary marks which words still have a free slot, so the lowest free slot is found
+// with a couple of find-first-set instructions, and occupied slots are walked 64 at a time
+typedef struct
+{
+	int size; // Number of slots
+	int words; // Number of 64 bit words in live
+	int summaryWords; // Number of 64 bit words in summary
+	uint64_t* live; // Bit set means slot is occupied. Bits past size are kept set so they are never handed out
+	uint64_t* summary; // Bit set means the matching word of live has at least one free slot
+} slotMap;
+
+// Function to set up a slot map with every slot free
+static inline void slotMapInit(slotMap* map, int size)
+{
+	map->size = size;
+	map->words = (size + 63) / 64;
+	map->summaryWords = (map->words + 63) / 64;
+	map->live = (uint64_t*)calloc(map->words, sizeof(uint64_t));
+	map->summary = (uint64_t*)calloc(map->summaryWords, sizeof(uint64_t));
+
+	// Mark the unused tail of the last word as occupied
+	if (size % 64 != 0)
+		map->live[map->words - 1] = ~0ULL << (size % 64);
+	// Every word starts with a free slot
+	for (int w = 0; w < map->words; w++)
+		map->summary[w / 64] |= 1ULL << (w % 64);
+}
+
+// Function to take the lowest free slot. Returns its index, or -1 if every slot is occupied
+static inline int slotAlloc(slotMap* map)
+{
+	for (int s = 0; s < map->summaryWords; s++)
+	{
+		if (map->summary[s] == 0)
+			continue;
+		int w = s * 64 + __builtin_ctzll(map->summary[s]);
+		int bit = __builtin_ctzll(~map->live[w]);
+		map->live[w] |= 1ULL << bit;
+		// Clear summary bit once the word is full
+		if (map->live[w] == ~0ULL)
+			map->summary[s] &= ~(1ULL << (w % 64));
+		return w * 64 + bit;
+	}
+	return -1;
+}
+
+// Function to give a slot back
+static inline void slotFree(slotMap* map, int slot)
+{
+	int w = slot / 64;
+	map->live[w] &= ~(1ULL << (slot % 64));
+	map->summary[w / 64] |= 1ULL << (w % 64);
+}
+
+// Function to find the first occupied slot at or after from. Returns -1 if there are none
+// Walk every occupied slot with: for (int i = slotNextLive(map, 0); i != -1; i = slotNextLive(map, i + 1))
+static inline int slotNextLive(const slotMap* map, int from)
+{
+	if (from >= map->size)
+		return -1;
+	int w = from / 64;
+	uint64_t bits = map->live[w] & (~0ULL << (from % 64));
+	while (bits == 0)
+	{
+		if (++w >= map->words)
+			return -1;
+		bits = map->live[w];
+	}
+	int slot = w * 64 + __builtin_ctzll(bits);
+	return slot < map->size ? slot : -1;
+}
+
+#endif
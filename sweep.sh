@@ -0,0 +1,75 @@
+#!/bin/bash
+# Runs oss over a grid of scheduling policies, table sizes, simulated CPUs and workload mixes, as many runs at a time
+# as the host has cores, and prints one table of every run's final statistics. Results are also saved to sweep.txt
+# Each run uses IPC objects of its own, so runs do not see each other. Rows are printed in grid order
+# Each dimension can be overridden from the environment, for example: POLICIES="mlfq cfs" MIXES="20,30" ./sweep.sh
+# EXTRA adds options to every run, for example: EXTRA="-m -p" ./sweep.sh. Do not add -f, every run would share ossLog.txt
+# CPUFLAG is the option the CPUS are given with, -c by default. CPUFLAG=-M simulates that many CPUs with queues of
+# their own, and CPUFLAG=-M CPUS="1 4:rr,home,nosteal 4:rr,home" compares placements
+
+JOBS=${JOBS:-1000}
+POLICIES=${POLICIES:-"mlfq boost lottery stride cfs"}
+TABLES=${TABLES:-"18 64"}
+CPUS=${CPUS:-"1 4"}
+CPUFLAG=${CPUFLAG:--c}
+MIXES=${MIXES:-"20,30 5,10 10,70"}
+EXTRA=${EXTRA:-""}
+PARALLEL=${PARALLEL:-$(nproc)}
+OUT=${OUT:-sweep.txt}
+
+runs=$(mktemp -d)
+trap 'rm -rf "$runs"' EXIT
+
+# Function to run oss once and turn its final statistics into one row of the table
+run() {
+	local out=$1 policy=$2 table=$3 cpus=$4 mix=$5
+	local args="-e -a 0 -n $JOBS -s $table $CPUFLAG $cpus -w $mix -P $policy $EXTRA"
+	if ! ./oss $args > "$out.log" 2>&1; then
+		echo "sweep: ./oss $args failed, see its output below" >&2
+		cat "$out.log" >&2
+		return 1
+	fi
+	awk -v policy="$policy" -v table="$table" -v cpus="$cpus" -v mix="$mix" '
+		/^Total simulated time:/ { sim = $4 }
+		/^Terminated processes:/ { done = $3 }
+		/^Average turnaround time:/ { turnaround = $4 }
+		/^Average CPU service time:/ { service = $5 }
+		/^Average wait time:/ { wait = $4 }
+		/^CPU utilization:/ { util = $3 }
+		/^Total CPU idle time:/ { idle = $5 }
+		$1 == "response" && $2 == "all" { response99 = $6 }
+		$1 == "turnaround" && $2 == "all" { turnaround99 = $6 }
+		END {
+			printf "%-8s %5s %4s %-6s %6s %14s %13s %13s %13s %4s %13s %13s %14s\n", policy, table, cpus, mix, done,
+					sim, turnaround, service, wait, util, idle, response99, turnaround99
+		}' "$out.log" > "$out"
+}
+
+# Start every run, keeping up to PARALLEL going at once
+n=0
+for policy in $POLICIES; do
+	for table in $TABLES; do
+		for cpus in $CPUS; do
+			for mix in $MIXES; do
+				while [ "$(jobs -rp | wc -l)" -ge "$PARALLEL" ]; do
+					wait -n
+				done
+				run "$runs/$(printf %05d $n)" "$policy" "$table" "$cpus" "$mix" &
+				n=$((n + 1))
+			done
+		done
+	done
+done
+wait
+
+# Collect the rows in the order the grid was walked. A run that failed left no row
+for ((i = 0; i < n; i++)); do
+	[ -f "$runs/$(printf %05d $i)" ] || exit 1
+done
+{
+	printf "%-8s %5s %4s %-6s %6s %14s %13s %13s %13s %4s %13s %13s %14s\n" "policy" "table" "cpus" "mix" "jobs" \
+			"sim_ns" "turnaround_ns" "service_ns" "wait_ns" "util" "idle_ns" "response_p99" "turnaround_p99"
+	for ((i = 0; i < n; i++)); do
+		cat "$runs/$(printf %05d $i)"
+	done
+} | tee "$OUT"
@@ -0,0 +1,179 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace.h"
+
+// Size of the stdio buffer used while recording, so records reach the file in large writes
+#define TRACE_BUF_SIZE (1024 * 1024)
+
+static const char traceMagic[8] = {'M', 'L', 'F', 'Q', 'T', 'R', 'C', '1'};
+
+static FILE* recordFile = NULL; // Trace being recorded
+static char* recordBuf = NULL; // Buffer for recordFile
+
+static void* mapped = NULL; // Trace being replayed, mapped read-only
+static size_t mappedSize = 0;
+static const traceRecord* records = NULL; // First record in the mapping
+static int* nextRec = NULL; // Index of the next record of the same kind and job, -1 at the end of a chain
+static int spawnHead = -1; // Next spawn record
+static int* runHead = NULL; // Next run record of each job
+static int* blockHead = NULL; // Next block record of each job
+static int jobCount = 0; // Number of jobs with a record in the trace
+
+int traceRecordOpen(const char* path)
+{
+	recordFile = fopen(path, "wb");
+	if (recordFile == NULL)
+		return -1;
+	recordBuf = (char*)malloc(TRACE_BUF_SIZE);
+	setvbuf(recordFile, recordBuf, _IOFBF, TRACE_BUF_SIZE);
+
+	traceHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, traceMagic, sizeof(traceMagic));
+	header.recordSize = sizeof(traceRecord);
+	fwrite(&header, sizeof(header), 1, recordFile);
+	return 0;
+}
+
+void traceAdd(int kind, int job, int status, int a, int b)
+{
+	if (recordFile == NULL)
+		return;
+	traceRecord rec;
+	rec.job = job;
+	rec.kind = kind;
+	rec.status = status;
+	rec.a = a;
+	rec.b = b;
+	fwrite(&rec, sizeof(rec), 1, recordFile);
+}
+
+int traceReplayOpen(const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return -1;
+	struct stat st;
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(traceHeader))
+	{
+		close(fd);
+		return -1;
+	}
+	mappedSize = st.st_size;
+	mapped = mmap(NULL, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		mapped = NULL;
+		return -1;
+	}
+
+	// Check file was written by a compatible build
+	const traceHeader* header = (const traceHeader*)mapped;
+	if (memcmp(header->magic, traceMagic, sizeof(traceMagic)) != 0 || header->recordSize != sizeof(traceRecord))
+	{
+		traceClose();
+		return -1;
+	}
+	records = (const traceRecord*)(header + 1);
+	int count = (mappedSize - sizeof(traceHeader)) / sizeof(traceRecord);
+
+	// Find how many job numbers the trace uses, and how many jobs were spawned
+	// The delay before the next spawn is always drawn right after a spawn, so the last delay was never used
+	int spawns = 0;
+	for (int i = 0; i < count; i++)
+	{
+		if ((int)records[i].job >= jobCount)
+			jobCount = records[i].job + 1;
+		if (records[i].kind == TRACE_SPAWN)
+			spawns++;
+	}
+
+	// Chain each job's records of each kind together, walking backwards so every chain ends up in file order
+	nextRec = new int[count];
+	runHead = new int[jobCount];
+	blockHead = new int[jobCount];
+	for (int j = 0; j < jobCount; j++)
+	{
+		runHead[j] = -1;
+		blockHead[j] = -1;
+	}
+	for (int i = count - 1; i >= 0; i--)
+	{
+		int* head;
+		if (records[i].kind == TRACE_SPAWN)
+			head = &spawnHead;
+		else if (records[i].kind == TRACE_RUN)
+			head = &runHead[records[i].job];
+		else if (records[i].kind == TRACE_BLOCK)
+			head = &blockHead[records[i].job];
+		else
+			continue;
+		nextRec[i] = *head;
+		*head = i;
+	}
+	return spawns > 0 ? spawns - 1 : 0;
+}
+
+long long traceNextSpawn()
+{
+	if (spawnHead == -1)
+		return -1;
+	const traceRecord* rec = &records[spawnHead];
+	spawnHead = nextRec[spawnHead];
+	return rec->a;
+}
+
+int traceNextRun(int job, int* status, int* quantum, int* used)
+{
+	if (job >= jobCount || runHead[job] == -1)
+		return -1;
+	const traceRecord* rec = &records[runHead[job]];
+	runHead[job] = nextRec[runHead[job]];
+	*status = rec->status;
+	*quantum = rec->a;
+	*used = rec->b;
+	return 0;
+}
+
+int traceNextBlock(int job, int* sec, int* ns)
+{
+	if (job >= jobCount || blockHead[job] == -1)
+		return -1;
+	const traceRecord* rec = &records[blockHead[job]];
+	blockHead[job] = nextRec[blockHead[job]];
+	*sec = rec->a;
+	*ns = rec->b;
+	return 0;
+}
+
+void traceClose()
+{
+	if (recordFile != NULL)
+	{
+		fclose(recordFile);
+		recordFile = NULL;
+		free(recordBuf);
+		recordBuf = NULL;
+	}
+	if (mapped != NULL)
+	{
+		munmap(mapped, mappedSize);
+		mapped = NULL;
+		delete[] nextRec;
+		delete[] runHead;
+		delete[] blockHead;
+		nextRec = runHead = blockHead = NULL;
+		jobCount = 0;
+	}
+}
+
+int traceReplaying()
+{
+	return mapped != NULL;
+}
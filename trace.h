@@ -0,0 +1,60 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Workload traces
+// Record mode streams every random decision of a run to a binary file: each spawn delay, the outcome of each
+// dispatch and each block duration. Replay mode maps that file into memory and hands the same decisions back,
+// so two versions of the scheduler can be compared on identical input. Run outcomes and block durations are
+// looked up by job and by how many the job has used so far, so they stay with the job even if a scheduling
+// change reorders dispatches
+
+// Kinds of trace record
+#define TRACE_SPAWN 1 // a = delay in ns before job is spawned
+#define TRACE_RUN 2 // status = worker reply, a = quantum given in ns, b = quantum used in ns
+#define TRACE_BLOCK 3 // a = seconds blocked, b = ns blocked
+
+// One record in a trace file. Files start with a traceHeader followed by these, in the order they happened
+typedef struct
+{
+	uint32_t job; // Job number, counting spawns from 0
+	int16_t kind; // TRACE_SPAWN, TRACE_RUN or TRACE_BLOCK
+	int16_t status; // Worker reply for TRACE_RUN: 0 (terminated), 1 (used full quantum) or -1 (blocked)
+	int32_t a;
+	int32_t b;
+} traceRecord;
+
+// Header at the start of every trace file
+typedef struct
+{
+	char magic[8]; // "MLFQTRC1"
+	uint32_t recordSize; // sizeof(traceRecord), to catch files written by an incompatible build
+	uint32_t reserved;
+} traceHeader;
+
+// Function to create a trace file and start recording to it. Returns 0 on success, -1 on failure
+int traceRecordOpen(const char* path);
+
+// Function to add a record to the trace being recorded. Does nothing if not recording
+void traceAdd(int kind, int job, int status, int a, int b);
+
+// Function to map a trace file for replay. Returns the number of jobs spawned in it, or -1 if it can not be used
+int traceReplayOpen(const char* path);
+
+// Function to get the next spawn delay in ns. Returns -1 once the trace has no more spawns
+long long traceNextSpawn();
+
+// Function to get job's next run outcome. Returns 0 on success, -1 if the trace has no more for this job
+int traceNextRun(int job, int* status, int* quantum, int* used);
+
+// Function to get job's next block duration. Returns 0 on success, -1 if the trace has no more for this job
+int traceNextBlock(int job, int* sec, int* ns);
+
+// Function to flush and close a recorded trace, or unmap a replayed one
+void traceClose();
+
+// Function to check if a trace is being replayed
+int traceReplaying();
+
+#endif
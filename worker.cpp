@@ -8,8 +8,11 @@
 #include <sys/msg.h>
 #include <cstdio>
 #include <cstdlib>
+#include "mailbox.h"
+#include "simclock.h"
+#include "cpuload.h"
+#include "jobmodel.h"
 
-#define PERMS 0644
 typedef struct msgbuffer
 {
 	long mtype;
@@ -17,29 +20,42 @@ typedef struct msgbuffer
 	int intData;
 } msgbuffer;
 
-int *shm_ptr;
-int shm_id;
+simClock* sysClock; // System clock kept by oss
+int shm_id; // IDs of the clock, mailboxes and queues oss created for this run, given with -i
+int mb_id = -1;
+
+mailboxHeader* mbHeader = NULL; // Mailbox shared memory when using mailbox transport
+mailbox* mb = NULL; // This worker's mailbox
+int mbSpin = 0; // Amount of times to poll mailbox before sleeping on its futex
+uint32_t mbSeen = 0; // Last dispatch seen in mailbox, oss resets the mailbox to 0 before forking
+
+// Workload mix given by oss with -w, and the most CPU time a job may use given with -t
+jobMix mix = {20, 30, 0};
+// Job being run, with its own random numbers
+jobState job;
+
+// Outcome oss gave with the last quantum when it is replaying a trace
+int scripted = 0;
+int scriptStatus = 0;
+int scriptUsed = 0;
+
+// Real work done for the time used in each quantum, given by oss with -l kind:units
+int loadKind = LOAD_NONE;
+long long loadUnitsPerSec = 0; // Units of work per simulated second
+
+// Most quanta oss lets this worker run back to back before replying, given with the last quantum
+int grant = 1;
+
+int msqid = 0; // Queue for messages from oss
+int rmsqid = 0; // Queue for replies to oss
 
 // Function to attach to shared memory
 void shareMem()
 {
-	// Generate key
-	const int sh_key = ftok("main.c", 0);
-	// Access shared memory
-	shm_id = shmget(sh_key, sizeof(int) * 2, 0666);
-
-	// Determine if shared memory access not successful
-	if (shm_id == -1)
-	{
-		// If true, print error message and exit 
-		fprintf(stderr, "Child: Shared memory get failed.\n");
-		exit(1);
-	}
-
 	// Attach shared memory
-	shm_ptr = (int *)shmat(shm_id, 0, 0);
+	sysClock = (simClock *)shmat(shm_id, 0, 0);
 	//Determine if insuccessful
-	if (shm_ptr == (int *)-1)
+	if (sysClock == (simClock *)-1)
 	{
 		// If true, print error message and exit
 		fprintf(stderr, "Child: Shared memory attach failed.\n");
@@ -47,35 +63,46 @@ void shareMem()
 	}
 }
 
-
-int main(int argc, char* argv[])
+// Function to attach to mailbox shared memory and find this worker's mailbox
+void mailboxMem(int slot)
 {
-	shareMem();
-	
-	// Info needed for message sending/receiving
-	msgbuffer buf;
-	buf.mtype = 1;
-	int msqid = 0;
-	key_t key;
-
-	// Get key for message queue
-	if ((key = ftok("msgq.txt", 1)) == -1)
+	// Attach shared memory
+	mbHeader = (mailboxHeader *)shmat(mb_id, 0, 0);
+	if (mbHeader == (mailboxHeader *)-1)
 	{
-		perror("ftok");
+		fprintf(stderr, "Child: Mailbox shared memory attach failed.\n");
 		exit(1);
 	}
+	// Mailboxes follow the header
+	mb = &((mailbox *)(mbHeader + 1))[slot];
+
+	// Only spin before sleeping if there is another core for oss to run on
+	if (sysconf(_SC_NPROCESSORS_ONLN) > 1)
+		mbSpin = MB_SPIN;
+}
 
-	// Create message queue
-	if ((msqid = msgget(key, PERMS)) == -1)
+// Function to wait for oss to give this worker a time quantum
+// A pool worker reseeds its random numbers when oss hands it a new job. Returns -1 if a pool worker should exit
+int receiveQuantum()
+{
+	if (mb != NULL)
 	{
-		perror("msgget in child\n");
-		exit(1);
+		// Wait for oss to post a quantum
+		mbSeen = mbWait(&mb->dispatchSeq, &mb->workerSleeping, mbSeen, mbSpin);
+		if (mb->newJob)
+		{
+			jobStart(&job, mb->seed);
+			mb->newJob = 0;
+		}
+		scripted = mb->scripted;
+		scriptStatus = mb->scriptStatus;
+		scriptUsed = mb->scriptUsed;
+		grant = mb->grant;
+		return mb->quantum;
 	}
 
-	srand(getpid());
-
-	// Loop that loop suntil determined end time is reached
-	while(true)
+	msgbuffer buf;
+	while (true)
 	{
 		// Receive message from parent
 		if (msgrcv(msqid, &buf, sizeof(msgbuffer) - sizeof(long), getpid(), 0) == -1)
@@ -84,64 +111,123 @@ int main(int argc, char* argv[])
 			exit(1);
 		}
 
-		// Get time quantum given from parent in message. This is amount of time child runs
-		int quantum = buf.intData;
-
-		// Generate random number to determine child's outcome in this iteration
-		int outcome = rand() % 100;
-		// Bool to represent if child should terminate, set to false initially
-		bool termNow = false;
-		bool blockNow = false;
-		// Stores what child's time quantum will be based on outcome generated. Initally set to full quantum
-		int effQuantum = quantum;
-
-		// If less than 20, early termination
-		if (outcome < 20)
-		{
-			// If quantum is greater than 1, set effQuantum to random number less than full quantum
-			if (quantum > 1)
-				effQuantum = rand() % quantum;
-			// Else set effQuantum to the full quantum
-			else
-				effQuantum = quantum;
-			// Set to true, so process will temrinate after using effQuantum time
-			termNow = true;
-		}
-		// Else outcome between 20-49, simulate I/O interrupt. Process will not terminate after this iteration
-		else if (outcome < 50)
-		{
-			// If quantum is greater than 1, set effQuantum to random number less than full quantum
-			if (quantum > 1)
-				effQuantum = rand() % quantum;
-			// Else set effQuantum to full quantum
-			else effQuantum = quantum;
-			blockNow = true;
-		}
-		
-
-		// Get info to send message back to parent
-		buf.mtype = getpid();
-	 	buf.intData = effQuantum;	
-		if (termNow)
-			strcpy(buf.strData, "0");
-		else if (blockNow)
-			strcpy(buf.strData, "-1");
+		// Pool worker is being handed a new job, intData holds its random seed
+		if (strcmp(buf.strData, "job") == 0)
+			jobStart(&job, buf.intData);
+		// Pool worker is being shut down
+		else if (strcmp(buf.strData, "stop") == 0)
+			return -1;
+		// Otherwise it is a time quantum. This is amount of time child runs
+		// When oss is replaying a trace, the message also holds how this quantum turns out, and when it grants
+		// a run of quanta, how many
 		else
-			strcpy(buf.strData, "1");
-
-		// Send message back to parent that process is still running
-		if (msgsnd(msqid, &buf, sizeof(msgbuffer)-sizeof(long), 0) == -1)
 		{
-			perror("msgsnd to parent failed.\n");
-			exit(1);
+			scripted = sscanf(buf.strData, "replay %d %d", &scriptStatus, &scriptUsed) == 2;
+			if (sscanf(buf.strData, "grant %d", &grant) != 1)
+				grant = 1;
+			return buf.intData;
 		}
+	}
+}
+
+// Function to send outcome of a grant back to oss: how many quanta were run, and how the last one ended
+void sendReply(int runs, int status, int effQuantum)
+{
+	if (mb != NULL)
+	{
+		// Post reply in mailbox
+		mb->runs = runs;
+		mb->status = status;
+		mb->used = effQuantum;
+		mb->replySeq.fetch_add(1, std::memory_order_release);
+		// Let oss know some worker has replied
+		mbPost(&mbHeader->replySeq, &mbHeader->ossSleeping);
+		return;
+	}
+
+	// Get info to send message back to parent
+	msgbuffer buf;
+	buf.mtype = getpid();
+	buf.intData = effQuantum;
+	if (runs > 1)
+		snprintf(buf.strData, sizeof(buf.strData), "%d %d", status, runs);
+	else if (status == 0)
+		strcpy(buf.strData, "0");
+	else if (status == -1)
+		strcpy(buf.strData, "-1");
+	else
+		strcpy(buf.strData, "1");
+
+	// Send message back to parent that process is still running
+	if (msgsnd(rmsqid, &buf, sizeof(msgbuffer)-sizeof(long), 0) == -1)
+	{
+		perror("msgsnd to parent failed.\n");
+		exit(1);
+	}
+}
 
-		if (termNow)
+int main(int argc, char* argv[])
+{
+	int slot = -1; // Table index when oss dispatches through mailboxes (-m)
+	int pool = 0; // Set when this worker is part of oss's pre-forked pool (-p) and runs job after job
+	int opt;
+	while ((opt = getopt(argc, argv, "i:m:pw:t:l:")) != -1)
+	{
+		if (opt == 'i')
+			sscanf(optarg, "%d,%d,%d,%d", &shm_id, &msqid, &rmsqid, &mb_id);
+		else if (opt == 'm')
+			slot = atoi(optarg);
+		else if (opt == 'p')
+			pool = 1;
+		else if (opt == 'w')
+			sscanf(optarg, "%d,%d", &mix.termPct, &mix.blockPct);
+		else if (opt == 't')
+			mix.runLimitNs = atoll(optarg);
+		else if (opt == 'l')
+			sscanf(optarg, "%d:%lld", &loadKind, &loadUnitsPerSec);
+	}
+
+	shareMem();
+
+	jobStart(&job, getpid());
+
+	// Set up the load once, a pool worker keeps its buffer from job to job
+	loadInit(loadKind);
+
+	// A table index means oss is dispatching through shared-memory mailboxes, otherwise it uses the queues
+	if (slot >= 0)
+		mailboxMem(slot);
+
+	// Loop that loop suntil determined end time is reached
+	while(true)
+	{
+		// Get time quantum given from parent
+		int quantum = receiveQuantum();
+		if (quantum < 0)
+			break;
+
+		// Determine child's outcome in this iteration, or take the one oss scripted. With a grant, keep running
+		// quanta until one does not use its whole quantum or the grant is used up, then send the outcome to parent
+		int effQuantum = scriptUsed;
+		int status;
+		int runs = 0;
+		do
+		{
+			status = scripted ? scriptStatus : jobQuantum(&job, &mix, quantum, &effQuantum);
+			// Do real work for the part of the quantum used
+			if (loadKind != LOAD_NONE)
+				loadRun(loadKind, (long long)effQuantum * loadUnitsPerSec / 1000000000);
+			runs++;
+		} while (status == 1 && runs < grant);
+		sendReply(runs, status, effQuantum);
+
+		// A pool worker stays around for its next job
+		if (status == 0 && !pool)
 			break;
 	}
 	
 	// Detach from memory
-	if (shmdt(shm_ptr) == -1)
+	if (shmdt(sysClock) == -1 || (mbHeader != NULL && shmdt(mbHeader) == -1))
 	{
 		perror("memory detach failed in worker\n");
 		exit(1);